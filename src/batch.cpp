@@ -0,0 +1,216 @@
+/******************************************
+ SkolemFC
+
+ Copyright (C) 2024, Arijit Shaw, Brendan Juba, and Kuldeep S. Meel.
+
+ All rights reserved.
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+***********************************************/
+
+#include "batch.h"
+
+#include <stdio.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+
+#include "json-escape.h"
+#include "thread-pool.h"
+
+using namespace SkolemFC;
+using SkolemFCInt::json_escape;
+using std::string;
+using std::vector;
+
+namespace {
+
+struct BatchInput
+{
+  string file;
+  uint64_t bytes = 0;
+  uint64_t mem_mb = 0;
+};
+
+// Parsing, F, G (about twice F) and the solvers working on them
+uint64_t estimate_mem_mb(const string& file, uint64_t bytes)
+{
+  const bool gz =
+      file.size() > 3 && file.compare(file.size() - 3, 3, ".gz") == 0;
+  const uint64_t raw = gz ? bytes * 5 : bytes;
+  return std::max<uint64_t>(64, raw * 64 / (1024 * 1024));
+}
+
+bool list_inputs(const string& inputs, vector<BatchInput>& out)
+{
+  namespace fs = std::filesystem;
+  std::error_code ec;
+  vector<string> files;
+  if (fs::is_directory(inputs, ec))
+  {
+    for (const auto& entry : fs::directory_iterator(inputs, ec))
+      if (entry.is_regular_file()) files.push_back(entry.path().string());
+    std::sort(files.begin(), files.end());
+  }
+  else
+  {
+    std::ifstream list(inputs);
+    if (!list) return false;
+    string line;
+    while (std::getline(list, line))
+    {
+      line.erase(0, line.find_first_not_of(" \t"));
+      line.erase(line.find_last_not_of(" \t\r") + 1);
+      if (line.empty() || line[0] == '#') continue;
+      files.push_back(line);
+    }
+  }
+
+  for (const string& f : files)
+  {
+    BatchInput in;
+    in.file = f;
+    struct stat st;
+    if (stat(f.c_str(), &st) == 0) in.bytes = st.st_size;
+    in.mem_mb = estimate_mem_mb(f, in.bytes);
+    out.push_back(in);
+  }
+  return true;
+}
+
+}  // namespace
+
+uint32_t SkolemFC::run_batch(const BatchOptions& opts, const BatchJob& run_one)
+{
+  vector<BatchInput> inputs;
+  if (!list_inputs(opts.inputs, inputs))
+  {
+    std::cerr << "ERROR: could not read batch input list '" << opts.inputs
+              << "'" << std::endl;
+    return 1;
+  }
+
+  FILE* out = stdout;
+  if (!opts.out.empty() && (out = fopen(opts.out.c_str(), "w")) == NULL)
+  {
+    std::cerr << "ERROR: could not open '" << opts.out << "' for writing"
+              << std::endl;
+    return 1;
+  }
+
+  // Longest first keeps the tail of the batch short
+  std::stable_sort(inputs.begin(),
+                   inputs.end(),
+                   [](const BatchInput& a, const BatchInput& b) {
+                     return a.bytes > b.bytes;
+                   });
+
+  std::mutex lock;
+  std::condition_variable mem_freed;
+  uint64_t mem_used = 0;
+  uint32_t running = 0;
+  uint32_t not_ok = 0;
+
+  SkolemFCInt::ThreadPool pool(std::max<uint32_t>(1, opts.jobs));
+  for (const BatchInput& in : inputs)
+  {
+    pool.submit([&, in](uint32_t) {
+      {
+        std::unique_lock<std::mutex> guard(lock);
+        mem_freed.wait(guard, [&]() {
+          return opts.mem_limit == 0 || running == 0
+                 || mem_used + in.mem_mb <= opts.mem_limit;
+        });
+        mem_used += in.mem_mb;
+        running++;
+      }
+
+      const auto start = std::chrono::steady_clock::now();
+      BatchResult r = run_one(in.file);
+      const double secs = std::chrono::duration<double>(
+                              std::chrono::steady_clock::now() - start)
+                              .count();
+
+      std::lock_guard<std::mutex> guard(lock);
+      mem_used -= in.mem_mb;
+      running--;
+      if (r.status != "ok") not_ok++;
+      fprintf(out,
+              "{\"file\":\"%s\",\"status\":\"%s\",\"log2_count\":\"%s\","
+              "\"iterations\":%llu,\"seconds\":%.3f,\"error\":\"%s\"}\n",
+              json_escape(in.file).c_str(),
+              r.status.c_str(),
+              r.log2_count.c_str(),
+              (unsigned long long)r.iterations,
+              secs,
+              json_escape(r.error).c_str());
+      fflush(out);
+      mem_freed.notify_all();
+    });
+  }
+  pool.wait();
+
+  if (out != stdout) fclose(out);
+  return not_ok;
+}
+
+namespace {
+// Text of this thread not yet handed to the target
+thread_local string pending_log;
+}  // namespace
+
+void SyncLogBuf::emit(size_t len)
+{
+  if (len == 0) return;
+  if (target)
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    target->sputn(pending_log.data(), len);
+  }
+  pending_log.erase(0, len);
+}
+
+int SyncLogBuf::overflow(int c)
+{
+  if (c == traits_type::eof()) return traits_type::not_eof(c);
+  pending_log.push_back((char)c);
+  if (c == '\n') emit(pending_log.size());
+  return c;
+}
+
+std::streamsize SyncLogBuf::xsputn(const char* s, std::streamsize n)
+{
+  pending_log.append(s, n);
+  emit(pending_log.rfind('\n') + 1);
+  return n;
+}
+
+int SyncLogBuf::sync()
+{
+  emit(pending_log.size());
+  if (!target) return 0;
+  std::lock_guard<std::mutex> guard(lock);
+  return target->pubsync();
+}
@@ -0,0 +1,86 @@
+/******************************************
+ SkolemFC
+
+ Copyright (C) 2024, Arijit Shaw, Brendan Juba, and Kuldeep S. Meel.
+
+ All rights reserved.
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+***********************************************/
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+namespace SkolemFC {
+
+struct BatchOptions
+{
+  std::string inputs;  // directory, or file listing one input per line
+  uint32_t jobs = 1;   // instances counted at once
+  uint64_t mem_limit = 0;  // MB all running jobs may use together, 0: none
+  std::string out;         // result lines, empty for stdout
+};
+
+// Outcome of one instance, reported as one JSON line
+struct BatchResult
+{
+  std::string status = "error";  // ok, failed or error
+  std::string log2_count;
+  uint64_t iterations = 0;
+  std::string error;
+};
+
+typedef std::function<BatchResult(const std::string& file)> BatchJob;
+
+// Expands opts.inputs and counts every instance with run_one on a shared
+// pool, largest input first. Jobs whose estimated memory would push the
+// running total over mem_limit wait for others to finish; a job larger
+// than the whole limit runs alone. Returns the number of instances that
+// did not end in "ok".
+uint32_t run_batch(const BatchOptions& opts, const BatchJob& run_one);
+
+// Stream buffer for the log that concurrent jobs all write through cout.
+// Each thread collects its text until a newline or a flush and hands it
+// over whole, under a lock, so lines of different jobs never mix and the
+// target is only ever written from one thread at a time. A null target
+// discards everything.
+class SyncLogBuf : public std::streambuf
+{
+ public:
+  explicit SyncLogBuf(std::streambuf* _target) : target(_target) {}
+
+ protected:
+  int overflow(int c) override;
+  std::streamsize xsputn(const char* s, std::streamsize n) override;
+  int sync() override;
+
+ private:
+  void emit(size_t len);
+
+  std::streambuf* target;
+  std::mutex lock;
+};
+
+}  // namespace SkolemFC
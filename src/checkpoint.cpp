@@ -0,0 +1,175 @@
+/******************************************
+ SkolemFC
+
+ Copyright (C) 2024, Arijit Shaw, Brendan Juba, and Kuldeep S. Meel.
+
+ All rights reserved.
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+***********************************************/
+
+#include "checkpoint.h"
+
+#include <stdio.h>
+#include <unistd.h>
+
+#include <cmath>
+#include <cstring>
+
+using namespace SkolemFCInt;
+
+static const char magic[8] = {'S', 'K', 'F', 'C', 'C', 'K', 'P', 'T'};
+static const uint32_t format_version = 3;
+
+template <typename T>
+static bool put(FILE* f, const T& v)
+{
+  return fwrite(&v, sizeof(T), 1, f) == 1;
+}
+
+template <typename T>
+static bool get(FILE* f, T& v)
+{
+  return fread(&v, sizeof(T), 1, f) == 1;
+}
+
+static bool put_mpz(FILE* f, const mpz_class& v)
+{
+  const std::string s = v.get_str(16);
+  const uint64_t len = s.size();
+  return put(f, len) && fwrite(s.data(), 1, len, f) == len;
+}
+
+static bool get_mpz(FILE* f, mpz_class& v)
+{
+  uint64_t len;
+  if (!get(f, len) || len > (1ULL << 24)) return false;
+  std::string s(len, '\0');
+  if (fread(&s[0], 1, len, f) != len) return false;
+  return v.set_str(s, 16) == 0;
+}
+
+bool Checkpoint::write(const std::string& path) const
+{
+  const std::string tmp = path + ".tmp";
+  FILE* f = fopen(tmp.c_str(), "wb");
+  if (f == NULL) return false;
+
+  const uint8_t have = (have_est0 ? 1 : 0) | (have_s2 ? 2 : 0)
+                       | (have_sample_num ? 4 : 0);
+  const uint64_t npending = sums.pending.size();
+  bool ok = fwrite(magic, 1, sizeof(magic), f) == sizeof(magic)
+            && put(f, format_version) && put(f, formula_hash)
+            && put(f, seed) && put(f, epsilon) && put(f, delta)
+            && put(f, thresh) && put(f, num_exists)
+            && put(f, sample_round_size) && put(f, oracle_flags)
+            && put(f, exact_residual_vars) && put(f, epsilon_gc)
+            && put(f, delta_gc) && put(f, ganak_time_limit)
+            && put(f, ganak_mem_limit)
+            && put(f, shard) && put(f, num_shards)
+            && put(f, have) && put_mpz(f, est0) && put_mpz(f, s2size)
+            && put(f, sample_num_est) && put(f, sums.next)
+            && put(f, sums.count) && put(f, sums.sum)
+            && put(f, oracle_samples) && put(f, engine_samples)
+            && put(f, epsilon_c) && put(f, max_error_logcounter)
+            && put(f, approxmc_threshold) && put(f, npending);
+  for (uint64_t i = 0; ok && i < npending; i++)
+    ok = put(f, sums.pending[i].first) && put(f, sums.pending[i].second);
+
+  ok = fflush(f) == 0 && ok;
+  ok = fsync(fileno(f)) == 0 && ok;
+  ok = fclose(f) == 0 && ok;
+  if (ok) ok = rename(tmp.c_str(), path.c_str()) == 0;
+  if (!ok) unlink(tmp.c_str());
+  return ok;
+}
+
+bool Checkpoint::read(const std::string& path)
+{
+  FILE* f = fopen(path.c_str(), "rb");
+  if (f == NULL) return false;
+
+  char m[sizeof(magic)];
+  uint32_t version = 0;
+  uint8_t have = 0;
+  uint64_t npending = 0;
+  bool ok = fread(m, 1, sizeof(m), f) == sizeof(m)
+            && memcmp(m, magic, sizeof(m)) == 0 && get(f, version)
+            && version == format_version && get(f, formula_hash)
+            && get(f, seed) && get(f, epsilon) && get(f, delta)
+            && get(f, thresh) && get(f, num_exists)
+            && get(f, sample_round_size) && get(f, oracle_flags)
+            && get(f, exact_residual_vars) && get(f, epsilon_gc)
+            && get(f, delta_gc) && get(f, ganak_time_limit)
+            && get(f, ganak_mem_limit)
+            && get(f, shard) && get(f, num_shards)
+            && get(f, have) && get_mpz(f, est0) && get_mpz(f, s2size)
+            && get(f, sample_num_est) && get(f, sums.next)
+            && get(f, sums.count) && get(f, sums.sum)
+            && get(f, oracle_samples) && get(f, engine_samples)
+            && get(f, epsilon_c) && get(f, max_error_logcounter)
+            && get(f, approxmc_threshold) && get(f, npending);
+  sums.pending.clear();
+  for (uint64_t i = 0; ok && i < npending; i++)
+  {
+    std::pair<uint64_t, double> p;
+    ok = get(f, p.first) && get(f, p.second);
+    if (ok) sums.pending.push_back(p);
+  }
+  fclose(f);
+
+  have_est0 = have & 1;
+  have_s2 = have & 2;
+  have_sample_num = have & 4;
+  return ok;
+}
+
+std::string Checkpoint::mismatch(const Checkpoint& run) const
+{
+  if (formula_hash != run.formula_hash) return "different formula";
+  if (seed != run.seed) return "different seed";
+  if (epsilon != run.epsilon || delta != run.delta)
+    return "different epsilon or delta";
+  if (num_exists != run.num_exists || thresh != run.thresh)
+    return "different |Y| or threshold";
+  if (sample_round_size != run.sample_round_size)
+    return "different sampling round size";
+  if (oracle_flags != run.oracle_flags
+      || exact_residual_vars != run.exact_residual_vars
+      || epsilon_gc != run.epsilon_gc || delta_gc != run.delta_gc
+      || ganak_time_limit != run.ganak_time_limit
+      || ganak_mem_limit != run.ganak_mem_limit)
+    return "different oracle options";
+  if (shard != run.shard || num_shards != run.num_shards)
+    return "different shard";
+  return "";
+}
+
+bool SkolemFCInt::oracle_error_exceeds(const mpf_class& count,
+                                       const mpz_class& s2size,
+                                       double approx_share,
+                                       double epsilon_c,
+                                       double max_error_logcounter,
+                                       uint32_t approxmc_threshold)
+{
+  if (s2size * (approx_share * log(1 + epsilon_c))
+      <= max_error_logcounter * count)
+    return false;
+  return count / s2size >= approxmc_threshold;
+}
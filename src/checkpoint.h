@@ -0,0 +1,98 @@
+/******************************************
+ SkolemFC
+
+ Copyright (C) 2024, Arijit Shaw, Brendan Juba, and Kuldeep S. Meel.
+
+ All rights reserved.
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+***********************************************/
+
+#pragma once
+
+#include <gmpxx.h>
+
+#include <cstdint>
+#include <string>
+
+#include "ordered-sum.h"
+
+namespace SkolemFCInt {
+
+// State of an estimation run that a later run can continue from. Samples
+// are not stored: round r is drawn from --seed and r alone, so the resumed
+// run samples again from the first round that is not fully reduced and
+// skips the indices whose counts the checkpoint already holds.
+// The same record, with every per-sample count in sums.pending, is what a
+// --shard run leaves for skolemfc-merge.
+struct Checkpoint
+{
+  // What the counts depend on; a checkpoint of another run is refused
+  uint64_t formula_hash = 0;
+  uint32_t seed = 0;
+  double epsilon = 0, delta = 0;
+  double thresh = 0;
+  uint32_t num_exists = 0;
+  uint64_t sample_round_size = 0;
+  uint32_t oracle_flags = 0;  // the boolean options below, one bit each
+  // Oracle options that change per-sample counts, Est0 or |S2|
+  uint32_t exact_residual_vars = 0;
+  double epsilon_gc = 0, delta_gc = 0;
+  double ganak_time_limit = 0;
+  uint64_t ganak_mem_limit = 0;
+  uint32_t shard = 0;
+  uint32_t num_shards = 1;
+
+  bool have_est0 = false;
+  bool have_s2 = false;
+  bool have_sample_num = false;
+  mpz_class est0 = 0;
+  mpz_class s2size = 0;
+  uint64_t sample_num_est = 0;
+
+  OrderedSum::Snapshot sums;
+
+  // What the oracle-error check needs, so that it covers the samples
+  // before a --resume, and skolemfc-merge can apply it to all shards
+  uint64_t oracle_samples = 0;  // sent to the approximate oracle
+  uint64_t engine_samples = 0;  // counted by the engine, 0 without it
+  double epsilon_c = 0;
+  double max_error_logcounter = 0;
+  uint32_t approxmc_threshold = 0;
+
+  // Written to path.tmp and renamed over path, so a reader only ever sees
+  // a complete checkpoint
+  bool write(const std::string& path) const;
+  bool read(const std::string& path);
+  // Empty when this checkpoint may be resumed by a run set up as `run`
+  std::string mismatch(const Checkpoint& run) const;
+};
+
+// Whether the error the approximate oracle may have added to the
+// samples' counts breaks the guarantee on count = Est0 + Est1. Only the
+// approx_share of the samples that went to the oracle carry that error.
+// Shared by a single run and skolemfc-merge.
+bool oracle_error_exceeds(const mpf_class& count,
+                          const mpz_class& s2size,
+                          double approx_share,
+                          double epsilon_c,
+                          double max_error_logcounter,
+                          uint32_t approxmc_threshold);
+
+}  // namespace SkolemFCInt
@@ -0,0 +1,205 @@
+/******************************************
+ SkolemFC
+
+ Copyright (C) 2024, Arijit Shaw, Brendan Juba, and Kuldeep S. Meel.
+
+ All rights reserved.
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+***********************************************/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <vector>
+
+#ifdef CMS_LOCAL_BUILD
+#include "cryptominisat.h"
+#else
+#include <cryptominisat5/cryptominisat.h>
+#endif
+
+namespace SkolemFCInt {
+
+using CMSat::Lit;
+
+// Read-only view of one clause, pointing into whatever stores it
+class ClauseRef
+{
+ public:
+  ClauseRef(const Lit* _lits, uint32_t _n) : lits(_lits), n(_n) {}
+
+  const Lit* begin() const { return lits; }
+  const Lit* end() const { return lits + n; }
+  uint32_t size() const { return n; }
+  bool empty() const { return n == 0; }
+  const Lit& operator[](uint32_t i) const { return lits[i]; }
+  bool operator==(const ClauseRef& other) const
+  {
+    if (n != other.n) return false;
+    for (uint32_t i = 0; i < n; i++)
+      if (lits[i] != other.lits[i]) return false;
+    return true;
+  }
+
+ private:
+  const Lit* lits;
+  uint32_t n;
+};
+
+// Clauses stored back to back in a single literal array, with a second array
+// marking where each clause starts (CSR layout). Two allocations for the
+// whole formula instead of one per clause, and a linear walk over memory for
+// everybody that reads it.
+class ClauseArena
+{
+ public:
+  ClauseArena() : starts(1, 0) {}
+  ClauseArena(const std::vector<std::vector<Lit>>& clauses) : ClauseArena()
+  {
+    for (const auto& clause : clauses) push_back(clause);
+  }
+
+  void clear()
+  {
+    lits.clear();
+    starts.assign(1, 0);
+  }
+  void reserve(size_t nclauses, size_t nlits)
+  {
+    starts.reserve(nclauses + 1);
+    lits.reserve(nlits);
+  }
+
+  template <typename Clause>
+  void push_back(const Clause& clause)
+  {
+    lits.insert(lits.end(), clause.begin(), clause.end());
+    starts.push_back(lits.size());
+  }
+  void push_back(std::initializer_list<Lit> clause)
+  {
+    lits.insert(lits.end(), clause.begin(), clause.end());
+    starts.push_back(lits.size());
+  }
+  void append(const ClauseArena& other)
+  {
+    reserve(size() + other.size(), num_lits() + other.num_lits());
+    const uint64_t shift = lits.size();
+    lits.insert(lits.end(), other.lits.begin(), other.lits.end());
+    for (size_t i = 1; i < other.starts.size(); i++)
+      starts.push_back(shift + other.starts[i]);
+  }
+
+  // Writes a clause in place: push_lit() as often as needed, then
+  // end_clause()
+  void push_lit(Lit l) { lits.push_back(l); }
+  void end_clause() { starts.push_back(lits.size()); }
+
+  size_t size() const { return starts.size() - 1; }
+  bool empty() const { return size() == 0; }
+  size_t num_lits() const { return lits.size(); }
+
+  ClauseRef operator[](size_t i) const
+  {
+    return ClauseRef(lits.data() + starts[i], starts[i + 1] - starts[i]);
+  }
+  // Literals of clause i may be rewritten in place, its length may not
+  Lit* mutable_begin(size_t i) { return lits.data() + starts[i]; }
+  Lit* mutable_end(size_t i) { return lits.data() + starts[i + 1]; }
+
+  bool operator==(const ClauseArena& other) const
+  {
+    return starts == other.starts && lits == other.lits;
+  }
+
+  class const_iterator
+  {
+   public:
+    const_iterator(const ClauseArena* _arena, size_t _at)
+        : arena(_arena), at(_at)
+    {
+    }
+    ClauseRef operator*() const { return (*arena)[at]; }
+    const_iterator& operator++()
+    {
+      at++;
+      return *this;
+    }
+    bool operator!=(const const_iterator& other) const
+    {
+      return at != other.at;
+    }
+
+   private:
+    const ClauseArena* arena;
+    size_t at;
+  };
+  const_iterator begin() const { return const_iterator(this, 0); }
+  const_iterator end() const { return const_iterator(this, size()); }
+
+ private:
+  std::vector<Lit> lits;
+  std::vector<uint64_t> starts;
+};
+
+// Non-owning view of a formula: up to two arenas followed by unit clauses.
+// F restricted by a sample is F's arena plus the sample's units, so nothing
+// of F is copied to express it.
+class FormulaView
+{
+ public:
+  FormulaView(const ClauseArena& _base) : base(&_base) {}
+
+  FormulaView& with(const ClauseArena& _extra)
+  {
+    extra = &_extra;
+    return *this;
+  }
+  FormulaView& with_units(const std::vector<Lit>& _units)
+  {
+    units = &_units;
+    return *this;
+  }
+
+  size_t size() const
+  {
+    return base->size() + (extra ? extra->size() : 0)
+           + (units ? units->size() : 0);
+  }
+
+  template <typename Func>
+  void for_each(Func&& f) const
+  {
+    for (ClauseRef clause : *base) f(clause);
+    if (extra)
+      for (ClauseRef clause : *extra) f(clause);
+    if (units)
+      for (const Lit& l : *units) f(ClauseRef(&l, 1));
+  }
+
+ private:
+  const ClauseArena* base;
+  const ClauseArena* extra = nullptr;
+  const std::vector<Lit>* units = nullptr;
+};
+
+}  // namespace SkolemFCInt
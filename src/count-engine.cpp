@@ -0,0 +1,211 @@
+/******************************************
+ SkolemFC
+
+ Copyright (C) 2024, Arijit Shaw, Brendan Juba, and Kuldeep S. Meel.
+
+ All rights reserved.
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+***********************************************/
+
+#include "count-engine.h"
+
+#include <arjun/arjun.h>
+
+#include <iomanip>
+#include <iostream>
+
+#include "time_mem.h"
+
+using namespace SkolemFCInt;
+
+void CountEngine::build(uint32_t _nvars,
+                        const ClauseArena& _clauses,
+                        uint32_t seed,
+                        uint32_t verbosity)
+{
+  double start_time = cpuTime();
+  nvars = _nvars;
+
+  // Every variable is kept in the sampling set and nothing is renumbered, so
+  // the simplified CNF has exactly the solutions of F over the original
+  // variables and X units can be applied to it directly.
+  vector<uint32_t> all_vars(nvars);
+  for (uint32_t i = 0; i < nvars; i++) all_vars[i] = i;
+
+  ArjunNS::Arjun* arjun = new ArjunNS::Arjun;
+  arjun->set_seed(seed);
+  arjun->set_verbosity(0);
+  arjun->set_simp(1);
+  arjun->new_vars(nvars);
+  vector<Lit> scratch;
+  for (ClauseRef clause : _clauses)
+  {
+    scratch.assign(clause.begin(), clause.end());
+    arjun->add_clause(scratch);
+  }
+  arjun->set_starting_sampling_set(all_vars);
+  const auto ret =
+      arjun->get_fully_simplified_renumbered_cnf(all_vars, false, false);
+  delete arjun;
+
+  // restrict() relies on the original numbering. Variables Arjun reports
+  // in empty_occs are left out of the sampling set but, having no clause
+  // in ret.cnf, still come out of restrict() as free_vars, so their factor
+  // of 2 is counted there and must not be applied again here. Anything
+  // else missing from the sampling set was projected away, and counting
+  // the residuals over nvars would then be wrong.
+  release_assert(ret.nvars == nvars);
+  vector<char> kept(nvars, 0);
+  for (uint32_t v : ret.sampling_vars)
+  {
+    release_assert(v < nvars);
+    kept[v] = 1;
+  }
+  uint32_t dropped = 0;
+  for (uint32_t v = 0; v < nvars; v++) dropped += !kept[v];
+  release_assert(dropped <= ret.empty_occs);
+
+  clauses.clear();
+  units.clear();
+  occs.assign(2 * (size_t)nvars, vector<uint32_t>());
+  trivially_unsat = false;
+  for (const auto& clause : ret.cnf)
+  {
+    if (clause.empty())
+    {
+      trivially_unsat = true;
+      continue;
+    }
+    if (clause.size() == 1)
+    {
+      release_assert(clause[0].var() < nvars && kept[clause[0].var()]);
+      units.push_back(clause[0]);
+      continue;
+    }
+    const uint32_t at = clauses.size();
+    for (const Lit& l : clause)
+    {
+      release_assert(l.var() < nvars && kept[l.var()]);
+      occs[l.toInt()].push_back(at);
+    }
+    clauses.push_back(clause);
+  }
+
+  ready = true;
+  prep_time = cpuTime() - start_time;
+  if (verbosity >= 1)
+  {
+    cout << "c [sklfc] count engine: F preprocessed once to " << clauses.size()
+         << " clauses and " << units.size() << " units in "
+         << std::setprecision(2) << std::fixed << prep_time << " s" << endl;
+  }
+}
+
+bool CountEngine::enqueue(Lit l, Scratch& s) const
+{
+  const int8_t val = l.sign() ? -1 : 1;
+  int8_t& cur = s.assigns[l.var()];
+  if (cur != 0) return cur == val;
+  cur = val;
+  s.trail.push_back(l);
+  return true;
+}
+
+bool CountEngine::propagate(Scratch& s) const
+{
+  for (size_t qhead = 0; qhead < s.trail.size(); qhead++)
+  {
+    const Lit p = s.trail[qhead];
+    for (uint32_t at : occs[p.toInt()]) s.sat[at] = 1;
+    for (uint32_t at : occs[(~p).toInt()])
+    {
+      if (s.sat[at]) continue;
+      const ClauseRef clause = clauses[at];
+      if (++s.n_false[at] + 1 < clause.size()) continue;
+
+      // At most one literal left: find it, or notice the clause is satisfied
+      Lit last = CMSat::lit_Undef;
+      for (const Lit& l : clause)
+      {
+        const int8_t a = s.assigns[l.var()];
+        if (a == 0)
+          last = l;
+        else if ((a == 1) != l.sign())
+        {
+          s.sat[at] = 1;
+          break;
+        }
+      }
+      if (s.sat[at]) continue;
+      if (last == CMSat::lit_Undef) return false;
+      if (!enqueue(last, s)) return false;
+    }
+  }
+  return true;
+}
+
+bool CountEngine::restrict(const SampleRef& sample,
+                           Scratch& s,
+                           Residual& out) const
+{
+  assert(ready);
+  out.clauses.clear();
+  out.nvars = 0;
+  out.free_vars = 0;
+  out.unsat = true;
+  if (trivially_unsat) return false;
+
+  s.assigns.assign(nvars, 0);
+  s.n_false.assign(clauses.size(), 0);
+  s.sat.assign(clauses.size(), 0);
+  s.trail.clear();
+
+  for (const Lit& l : units)
+  {
+    if (!enqueue(l, s)) return false;
+  }
+  for (uint32_t col = 0; col < sample.size(); col++)
+  {
+    if (!enqueue(sample.lit(col), s)) return false;
+  }
+  if (!propagate(s)) return false;
+
+  const uint32_t unmapped = std::numeric_limits<uint32_t>::max();
+  s.var_map.assign(nvars, unmapped);
+  for (uint32_t at = 0; at < clauses.size(); at++)
+  {
+    if (s.sat[at]) continue;
+    for (const Lit& l : clauses[at])
+    {
+      if (s.assigns[l.var()] != 0) continue;
+      uint32_t& mapped = s.var_map[l.var()];
+      if (mapped == unmapped) mapped = out.nvars++;
+      out.clauses.push_lit(Lit(mapped, l.sign()));
+    }
+    out.clauses.end_clause();
+  }
+
+  for (uint32_t v = 0; v < nvars; v++)
+  {
+    if (s.assigns[v] == 0 && s.var_map[v] == unmapped) out.free_vars++;
+  }
+  out.unsat = false;
+  return true;
+}
@@ -0,0 +1,89 @@
+/******************************************
+ SkolemFC
+
+ Copyright (C) 2024, Arijit Shaw, Brendan Juba, and Kuldeep S. Meel.
+
+ All rights reserved.
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+***********************************************/
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "sample-store.h"
+#include "skolemfc-int.h"
+
+using CMSat::Lit;
+using std::vector;
+
+namespace SkolemFCInt {
+
+// F restricted to one sampled X assignment. Variables are renumbered densely
+// and free_vars counts the variables that no longer occur in any clause, each
+// of which doubles the count of the residual.
+struct Residual
+{
+  uint32_t nvars = 0;
+  uint32_t free_vars = 0;
+  bool unsat = false;
+  ClauseArena clauses;
+};
+
+// Keeps F resident after a single preprocessing pass, so that counting one
+// sample only costs a propagation of its X units instead of a full Arjun run
+// over F and |X| unit clauses. The preprocessed formula is read-only after
+// build(); every counting thread passes its own Scratch to restrict().
+struct CountEngine
+{
+  struct Scratch
+  {
+    vector<int8_t> assigns;
+    vector<uint32_t> n_false;
+    vector<char> sat;
+    vector<Lit> trail;
+    vector<uint32_t> var_map;
+  };
+
+  void build(uint32_t nvars,
+             const ClauseArena& clauses,
+             uint32_t seed,
+             uint32_t verbosity);
+  bool built() const { return ready; }
+  bool restrict(const SampleRef& sample, Scratch& s, Residual& out) const;
+
+  // CPU time of the one-time preprocessing, i.e. what the rebuilding path
+  // paid again for every single sample
+  double prep_time = 0;
+
+ private:
+  bool enqueue(Lit l, Scratch& s) const;
+  bool propagate(Scratch& s) const;
+
+  bool ready = false;
+  bool trivially_unsat = false;
+  uint32_t nvars = 0;
+  ClauseArena clauses;
+  vector<Lit> units;
+  vector<vector<uint32_t>> occs;  // indexed by Lit::toInt()
+};
+
+}  // namespace SkolemFCInt
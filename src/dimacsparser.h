@@ -234,10 +234,9 @@ bool DimacsParser<C, S>::parse_header(C& in)
   {
     if (header_found && strict_header)
     {
-      std::cerr << "ERROR: CNF header ('p cnf vars cls') found twice in file! "
-                   "Exiting."
+      std::cerr << "ERROR: CNF header ('p cnf vars cls') found twice in file!"
                 << endl;
-      exit(-1);
+      return false;
     }
     header_found = true;
 
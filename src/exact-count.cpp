@@ -0,0 +1,177 @@
+/******************************************
+ SkolemFC
+
+ Copyright (C) 2024, Arijit Shaw, Brendan Juba, and Kuldeep S. Meel.
+
+ All rights reserved.
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+***********************************************/
+
+#include "exact-count.h"
+
+#include <cassert>
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#include <immintrin.h>
+#define SKLFC_AVX2_DISPATCH
+#endif
+
+using namespace SkolemFCInt;
+
+namespace {
+
+// Value of variable v < 6 on the 64 assignments of one word
+const uint64_t low_var_words[6] = {
+    0xAAAAAAAAAAAAAAAAULL,
+    0xCCCCCCCCCCCCCCCCULL,
+    0xF0F0F0F0F0F0F0F0ULL,
+    0xFF00FF00FF00FF00ULL,
+    0xFFFF0000FFFF0000ULL,
+    0xFFFFFFFF00000000ULL,
+};
+
+inline uint64_t lit_word(uint32_t lit, uint64_t block)
+{
+  const uint32_t var = lit >> 1;
+  uint64_t w;
+  if (var < 6)
+    w = low_var_words[var];
+  else
+    w = -((block >> (var - 6)) & 1);
+  return (lit & 1) ? ~w : w;
+}
+
+uint64_t count_words(const ClauseArena& f,
+                     uint64_t nblocks,
+                     uint64_t lane_mask)
+{
+  uint64_t total = 0;
+  for (uint64_t block = 0; block < nblocks; block++)
+  {
+    uint64_t acc = lane_mask;
+    for (size_t c = 0; c < f.size() && acc; c++)
+    {
+      uint64_t w = 0;
+      for (const Lit& l : f[c]) w |= lit_word(l.toInt(), block);
+      acc &= w;
+    }
+    total += __builtin_popcountll(acc);
+  }
+  return total;
+}
+
+#ifdef SKLFC_AVX2_DISPATCH
+// Four consecutive blocks per iteration, one per 64-bit lane
+__attribute__((target("avx2,popcnt"))) uint64_t count_words_avx2(
+    const ClauseArena& f, uint64_t nblocks)
+{
+  assert(nblocks % 4 == 0);
+  const __m256i ones = _mm256_set1_epi64x(-1);
+  uint64_t total = 0;
+  for (uint64_t block = 0; block < nblocks; block += 4)
+  {
+    __m256i acc = ones;
+    for (size_t c = 0; c < f.size(); c++)
+    {
+      __m256i w = _mm256_setzero_si256();
+      for (const Lit& l : f[c])
+      {
+        const uint32_t lit = l.toInt();
+        const uint32_t var = lit >> 1;
+        __m256i v;
+        if (var < 6)
+          v = _mm256_set1_epi64x(low_var_words[var]);
+        else
+        {
+          const uint32_t s = var - 6;
+          v = _mm256_set_epi64x(-(((block + 3) >> s) & 1),
+                                -(((block + 2) >> s) & 1),
+                                -(((block + 1) >> s) & 1),
+                                -((block >> s) & 1));
+        }
+        if (lit & 1) v = _mm256_xor_si256(v, ones);
+        w = _mm256_or_si256(w, v);
+      }
+      acc = _mm256_and_si256(acc, w);
+      if (_mm256_testz_si256(acc, acc)) break;
+    }
+    total += _mm_popcnt_u64(_mm256_extract_epi64(acc, 0));
+    total += _mm_popcnt_u64(_mm256_extract_epi64(acc, 1));
+    total += _mm_popcnt_u64(_mm256_extract_epi64(acc, 2));
+    total += _mm_popcnt_u64(_mm256_extract_epi64(acc, 3));
+  }
+  return total;
+}
+
+bool have_avx2()
+{
+  static const bool avx2 = __builtin_cpu_supports("avx2")
+                           && __builtin_cpu_supports("popcnt");
+  return avx2;
+}
+#endif
+
+}  // namespace
+
+namespace {
+
+uint64_t count_all(const Residual& r, bool allow_avx2)
+{
+  assert(r.nvars <= max_exact_enum_vars);
+  if (r.unsat) return 0;
+
+  const ClauseArena& f = r.clauses;
+  if (r.nvars < 6)
+  {
+    // Fewer than 64 assignments: only the low lanes of one word are real
+    const uint64_t lane_mask = (1ULL << (1U << r.nvars)) - 1;
+    return count_words(f, 1, lane_mask);
+  }
+
+  const uint64_t nblocks = 1ULL << (r.nvars - 6);
+#ifdef SKLFC_AVX2_DISPATCH
+  if (allow_avx2 && nblocks >= 4 && have_avx2())
+    return count_words_avx2(f, nblocks);
+#else
+  (void)allow_avx2;
+#endif
+  return count_words(f, nblocks, ~0ULL);
+}
+
+}  // namespace
+
+uint64_t SkolemFCInt::count_exhaustive(const Residual& r)
+{
+  return count_all(r, true);
+}
+
+uint64_t SkolemFCInt::count_exhaustive_scalar(const Residual& r)
+{
+  return count_all(r, false);
+}
+
+bool SkolemFCInt::count_exhaustive_uses_avx2()
+{
+#ifdef SKLFC_AVX2_DISPATCH
+  return have_avx2();
+#else
+  return false;
+#endif
+}
@@ -0,0 +1,51 @@
+/******************************************
+ SkolemFC
+
+ Copyright (C) 2024, Arijit Shaw, Brendan Juba, and Kuldeep S. Meel.
+
+ All rights reserved.
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+***********************************************/
+
+#pragma once
+
+#include <cstdint>
+
+#include "count-engine.h"
+
+namespace SkolemFCInt {
+
+// Residuals with more variables than this are never enumerated: 2^30
+// assignments is already far slower than an approximate oracle call
+static constexpr uint32_t max_exact_enum_vars = 30;
+
+// Counts the models of a residual exactly by evaluating every clause on all
+// 2^nvars assignments, 64 of them per machine word. Each word holds one bit
+// per assignment: the six lowest variables follow a fixed bit pattern within
+// the word, the others are constant across it. Uses 256-bit words instead
+// when the CPU supports AVX2.
+uint64_t count_exhaustive(const Residual& r);
+
+// The same count without the AVX2 dispatch, and whether count_exhaustive()
+// takes it on this CPU. Lets the tests hold both paths to the same answers.
+uint64_t count_exhaustive_scalar(const Residual& r);
+bool count_exhaustive_uses_avx2();
+
+}  // namespace SkolemFCInt
@@ -0,0 +1,268 @@
+/******************************************
+ SkolemFC
+
+ Copyright (C) 2024, Arijit Shaw, Brendan Juba, and Kuldeep S. Meel.
+
+ All rights reserved.
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+***********************************************/
+
+#include "ganak-runner.h"
+
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstring>
+#include <sstream>
+
+#include "profile.h"
+
+using namespace SkolemFCInt;
+
+namespace {
+const char* const memfd_prefix = "/proc/self/fd/";
+}  // namespace
+
+const char* GanakRunner::status_name(GanakResult::Status s)
+{
+  switch (s)
+  {
+    case GanakResult::ok:
+      return "ok";
+    case GanakResult::timeout:
+      return "timeout";
+    case GanakResult::memout:
+      return "memory limit";
+    case GanakResult::failed:
+      return "failed";
+  }
+  return "unknown";
+}
+
+static bool write_all(int fd, const char* data, size_t len)
+{
+  while (len > 0)
+  {
+    ssize_t n = write(fd, data, len);
+    if (n < 0)
+    {
+      if (errno == EINTR) continue;
+      return false;
+    }
+    data += n;
+    len -= n;
+  }
+  return true;
+}
+
+std::string GanakRunner::cnf_text(uint64_t nvars,
+                                  const FormulaView& clauses,
+                                  const std::vector<uint32_t>& projection)
+{
+  std::stringstream ss;
+  ss << "p cnf " << nvars << " " << clauses.size() << "\n";
+  if (!projection.empty())
+  {
+    ss << "c p show";
+    for (uint32_t var : projection) ss << " " << var + 1;
+    ss << " 0\n";
+  }
+  clauses.for_each([&](ClauseRef clause) {
+    for (const Lit& lit : clause) ss << lit << " ";
+    ss << "0\n";
+  });
+  return ss.str();
+}
+
+int GanakRunner::write_cnf(uint64_t nvars,
+                           const FormulaView& clauses,
+                           const std::vector<uint32_t>& projection,
+                           std::string& path)
+{
+  ProfileScope span(Probe::ganak_write);
+  const std::string cnf = cnf_text(nvars, clauses, projection);
+  span.add_bytes(cnf.size());
+
+  int fd = -1;
+#ifdef MFD_CLOEXEC
+  fd = memfd_create("skolemfc_cnf", MFD_CLOEXEC);
+#endif
+  if (fd >= 0)
+    path = memfd_prefix + std::to_string(fd);
+  else
+  {
+    // No memfd on this system: an unlinked-on-return temporary file
+    char tmp_name[] = "/tmp/skolemfc_cnf_XXXXXX";
+    fd = mkostemp(tmp_name, O_CLOEXEC);
+    if (fd < 0) return -1;
+    path = tmp_name;
+  }
+  if (!write_all(fd, cnf.data(), cnf.size()))
+  {
+    close(fd);
+    if (path.rfind(memfd_prefix, 0) != 0) unlink(path.c_str());
+    return -1;
+  }
+  lseek(fd, 0, SEEK_SET);
+  return fd;
+}
+
+GanakResult GanakRunner::count(uint64_t nvars,
+                               const FormulaView& clauses,
+                               const std::vector<uint32_t>& projection,
+                               const GanakLimits& limits)
+{
+  GanakResult result;
+  const auto start = std::chrono::steady_clock::now();
+  auto elapsed = [&]() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now()
+                                         - start)
+        .count();
+  };
+
+  {
+    auto guard = profiled_lock(lock);
+    if (running >= max_procs)
+    {
+      ProfileScope wait(Probe::lock_wait);
+      slot_free.wait(guard, [&]() { return running < max_procs; });
+    }
+    running++;
+  }
+
+  std::string path;
+  int cnf_fd = write_cnf(nvars, clauses, projection, path);
+  int out_pipe[2] = {-1, -1};
+  pid_t pid = -1;
+  // Stopped by the parent only: the child must not touch the profiler,
+  // whose locks another thread may have held at fork()
+  ProfileScope spawn(Probe::ganak_spawn);
+  if (cnf_fd >= 0 && pipe2(out_pipe, O_CLOEXEC) == 0) pid = fork();
+
+  if (pid == 0)
+  {
+    // Own process group, so a timeout takes down anything ganak started
+    setpgid(0, 0);
+    if (limits.mem_limit > 0)
+    {
+      struct rlimit rl;
+      rl.rlim_cur = rl.rlim_max = limits.mem_limit * 1024ULL * 1024ULL;
+      setrlimit(RLIMIT_AS, &rl);
+    }
+    // dup2() clears close-on-exec on stdout; the memfd is opened by path,
+    // so it is the one other descriptor to keep
+    dup2(out_pipe[1], STDOUT_FILENO);
+    if (path.rfind(memfd_prefix, 0) == 0) fcntl(cnf_fd, F_SETFD, 0);
+    execlp(binary.c_str(), binary.c_str(), path.c_str(), (char*)NULL);
+    perror("execlp");
+    _exit(127);
+  }
+
+  std::string output;
+  bool timed_out = false;
+  int status = 0;
+  spawn.stop();
+  if (pid > 0)
+  {
+    ProfileScope run(Probe::ganak_run);
+    setpgid(pid, pid);
+    close(out_pipe[1]);
+    char buffer[4096];
+    struct pollfd pfd = {out_pipe[0], POLLIN, 0};
+    for (;;)
+    {
+      int wait_ms = -1;
+      if (limits.time_limit > 0)
+      {
+        double left = limits.time_limit - elapsed();
+        if (left <= 0)
+        {
+          timed_out = true;
+          break;
+        }
+        wait_ms = (int)(left * 1000) + 1;
+      }
+      int ready = poll(&pfd, 1, wait_ms);
+      if (ready < 0 && errno == EINTR) continue;
+      if (ready == 0) continue;  // deadline re-checked above
+      ssize_t n = read(out_pipe[0], buffer, sizeof(buffer));
+      if (n < 0 && errno == EINTR) continue;
+      if (n <= 0) break;
+      output.append(buffer, n);
+    }
+    if (timed_out) kill(-pid, SIGKILL);
+    close(out_pipe[0]);
+    waitpid(pid, &status, 0);
+  }
+  else
+  {
+    perror("ganak");
+    if (out_pipe[0] >= 0)
+    {
+      close(out_pipe[0]);
+      close(out_pipe[1]);
+    }
+  }
+  if (cnf_fd >= 0)
+  {
+    close(cnf_fd);
+    if (path.rfind(memfd_prefix, 0) != 0) unlink(path.c_str());
+  }
+
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    running--;
+  }
+  slot_free.notify_one();
+
+  result.seconds = elapsed();
+  if (timed_out)
+  {
+    result.status = GanakResult::timeout;
+    return result;
+  }
+
+  const char* prefix = "c s exact arb int ";
+  std::istringstream iss(output);
+  std::string line;
+  while (getline(iss, line))
+  {
+    if (line.rfind(prefix, 0) == 0)
+    {
+      if (result.count.set_str(line.substr(strlen(prefix)), 10) == 0)
+        result.status = GanakResult::ok;
+      return result;
+    }
+  }
+
+  // No count: with an address-space limit, an allocation failure is by
+  // far the most likely cause of a crash
+  const bool crashed = WIFSIGNALED(status)
+                       || (WIFEXITED(status) && WEXITSTATUS(status) != 0);
+  result.status = (crashed && limits.mem_limit > 0) ? GanakResult::memout
+                                                   : GanakResult::failed;
+  return result;
+}
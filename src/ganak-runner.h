@@ -0,0 +1,104 @@
+/******************************************
+ SkolemFC
+
+ Copyright (C) 2024, Arijit Shaw, Brendan Juba, and Kuldeep S. Meel.
+
+ All rights reserved.
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+***********************************************/
+
+#pragma once
+
+#include <gmpxx.h>
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "clause-arena.h"
+
+namespace SkolemFCInt {
+
+struct GanakLimits
+{
+  double time_limit = 3600;  // wall-clock seconds, 0 for none
+  uint64_t mem_limit = 0;    // MB of address space, 0 for none
+};
+
+struct GanakResult
+{
+  enum Status
+  {
+    ok,
+    timeout,
+    memout,
+    failed,
+  };
+  Status status = failed;
+  mpz_class count = 0;
+  double seconds = 0;
+};
+
+// Runs the exact counter as a child process. The CNF goes through an
+// anonymous in-memory file (memfd) that the child opens as /proc/self/fd/N,
+// so no formula touches the disk. Every descriptor is close-on-exec, so a
+// child only inherits its own CNF and pipe, never those of concurrent
+// calls. Every call gets a wall-clock deadline, after
+// which the child's process group is killed, and an address-space limit
+// set in the child before exec. At most max_procs counters run at once;
+// further callers wait for a slot.
+class GanakRunner
+{
+ public:
+  GanakRunner(const std::string& _binary = "./ganak", uint32_t _max_procs = 2)
+      : binary(_binary), max_procs(_max_procs)
+  {
+  }
+
+  void set_binary(const std::string& _binary) { binary = _binary; }
+  void set_max_procs(uint32_t _max_procs) { max_procs = _max_procs; }
+
+  GanakResult count(uint64_t nvars,
+                    const FormulaView& clauses,
+                    const std::vector<uint32_t>& projection,
+                    const GanakLimits& limits);
+
+  static const char* status_name(GanakResult::Status s);
+  // DIMACS text of the formula, with the projection as a "c p show" line
+  static std::string cnf_text(uint64_t nvars,
+                              const FormulaView& clauses,
+                              const std::vector<uint32_t>& projection);
+
+ private:
+  int write_cnf(uint64_t nvars,
+                const FormulaView& clauses,
+                const std::vector<uint32_t>& projection,
+                std::string& path);
+
+  std::string binary;
+  uint32_t max_procs;
+  uint32_t running = 0;
+  std::mutex lock;
+  std::condition_variable slot_free;
+};
+
+}  // namespace SkolemFCInt
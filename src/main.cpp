@@ -46,9 +46,14 @@ namespace po = boost::program_options;
 
 #include <dimacsparser.h>
 
+#include "batch.h"
 #include "config.h"
+#include "profile.h"
+#include "qdimacs-reader.h"
+#include "serve.h"
 #include "skolemfc.h"
 #include "time_mem.h"
+#include "warm-cache.h"
 
 using std::cerr;
 using std::cout;
@@ -75,6 +80,13 @@ bool noguarantee = false;
 uint32_t use_unisamp_sampling = 1;
 uint32_t exactcount_f = 1;
 uint32_t exactcount_g = 0;
+uint32_t persistent_count = 1;
+uint32_t residual_cache = 1;
+uint32_t exact_residual_vars = 20;
+uint32_t decompose = 1;
+uint32_t eliminate_defined = 1;
+uint64_t definability_confl = 1000000;
+uint32_t pipeline = 1;
 uint32_t seed = 0;
 uint32_t nthreads = 8;
 double epsilon = 0.8;
@@ -88,6 +100,28 @@ string logfilename;
 SkolemFC::SklFC* skolemfc = NULL;
 string elimtofile;
 string recover_file;
+string sample_spill_dir;
+uint64_t mem_limit = 0;
+string ganak_path = "./ganak";
+double ganak_timeout = 3600;
+uint64_t ganak_mem = 0;
+uint32_t ganak_procs = 2;
+string checkpoint_path;
+double checkpoint_interval = 300;
+bool resume = false;
+string shard_spec;
+string shard_file;
+double shard_margin = 0.2;
+string batch_inputs;
+uint32_t batch_jobs = 0;
+uint64_t batch_mem = 0;
+string batch_out;
+string batch_log;
+string serve_socket;
+string stats_json;
+string trace_file;
+uint32_t shard_index = 0;
+uint32_t num_shards = 1;
 
 int recompute_sampling_set = 0;
 uint32_t orig_sampling_set_size = 0;
@@ -125,7 +159,85 @@ void add_skolemfc_options()
       "seed,s", po::value(&seed)->default_value(seed), "Seed")(
       "threads,j",
       po::value(&nthreads)->default_value(1),
-      "Number of threads to use")("version", "Print version info")
+      "Number of threads to use")(
+      "pipeline",
+      po::value(&pipeline)->default_value(pipeline),
+      "With more than one thread, stream samples to counting threads as they "
+      "are generated instead of sampling everything first")(
+      "decompose",
+      po::value(&decompose)->default_value(decompose),
+      "Split F into components that share only X variables and count each "
+      "one separately, with its own |Y| and G formula")(
+      "sample-spill",
+      po::value(&sample_spill_dir),
+      "Keep the packed samples in memory-mapped files in this directory "
+      "instead of RAM")(
+      "mem-limit",
+      po::value(&mem_limit)->default_value(mem_limit),
+      "MB of resident memory above which counting threads pause until usage "
+      "drops, trading speed for not running out of memory (0: no limit)")(
+      "eliminate-defined",
+      po::value(&eliminate_defined)->default_value(eliminate_defined),
+      "Find Y variables that X and the other Y variables define (Padoa's "
+      "method) and leave them out of |Y| and of the Y != Y' constraint of G")(
+      "checkpoint",
+      po::value(&checkpoint_path),
+      "Save the state of the run to this file periodically")(
+      "checkpoint-interval",
+      po::value(&checkpoint_interval)->default_value(checkpoint_interval),
+      "Seconds between checkpoints")(
+      "resume",
+      po::bool_switch(&resume)->default_value(resume),
+      "Continue from --checkpoint if it holds a run with the same formula "
+      "and parameters")(
+      "serve",
+      po::value(&serve_socket),
+      "Serve jobs on this Unix domain socket: each connection sends a "
+      "QDIMACS formula and gets the log and result back. Preprocessing, G "
+      "formulas and counts are kept for later jobs")(
+      "batch",
+      po::value(&batch_inputs),
+      "Count every instance in this directory, or listed one per line in "
+      "this file, in one process and print a JSON result line for each")(
+      "batch-jobs",
+      po::value(&batch_jobs)->default_value(batch_jobs),
+      "Instances counted at once in batch mode, each with --threads divided "
+      "among them (0: one per thread)")(
+      "batch-mem",
+      po::value(&batch_mem)->default_value(batch_mem),
+      "MB the running batch instances may use together, as estimated from "
+      "their input size (0: no limit)")(
+      "batch-out",
+      po::value(&batch_out),
+      "File for the batch result lines instead of stdout")(
+      "batch-log",
+      po::value(&batch_log),
+      "File for the log of the batch instances, discarded by default")(
+      "shard",
+      po::value(&shard_spec),
+      "Run shard i of n (given as i/n): draw every n-th sampling round, "
+      "stop at 1/n of the threshold and write the sample counts to "
+      "--shard-file for skolemfc-merge")(
+      "shard-file",
+      po::value(&shard_file),
+      "Output of --shard, default skolemfc-shard-<i>-of-<n>.bin")(
+      "shard-margin",
+      po::value(&shard_margin)->default_value(shard_margin),
+      "Fraction each shard runs past its share of the threshold")(
+      "stats-json",
+      po::value(&stats_json),
+      "Write the count, total, p50/p99 time and bytes of every profiled "
+      "span (oracle calls, G construction, Ganak runs, lock waits, ...) to "
+      "this JSON file")(
+      "trace",
+      po::value(&trace_file),
+      "Write every profiled span to this Chrome trace-event file, one track "
+      "per thread")(
+      "definability-confl",
+      po::value(&definability_confl)->default_value(definability_confl),
+      "Conflict budget of the whole definability pass; outputs left "
+      "untested when it runs out are kept")(
+      "version", "Print version info")
 
       ("epsilon,e",
        po::value(&epsilon)->default_value(epsilon, my_epsilon.str()),
@@ -166,6 +278,34 @@ void add_skolemfc_options()
       "exact-g",
       po::value(&exactcount_g)->default_value(exactcount_g),
       "Use Exact Counter to count size of set S2")(
+      "persistent-count",
+      po::value(&persistent_count)->default_value(persistent_count),
+      "Preprocess F once and count each sample on F restricted by its X "
+      "assignment. 0 rebuilds Arjun and ApproxMC on F for every sample")(
+      "residual-cache",
+      po::value(&residual_cache)->default_value(residual_cache),
+      "Cache counts of canonicalized residual formulas, so samples that "
+      "leave the same residual share one oracle call. Needs "
+      "--persistent-count")(
+      "exact-residual-vars",
+      po::value(&exact_residual_vars)->default_value(exact_residual_vars),
+      "Count residual formulas with at most this many variables exactly by "
+      "bit-parallel enumeration instead of ApproxMC (at most 30, 0 "
+      "disables). Needs --persistent-count")(
+      "ganak",
+      po::value(&ganak_path)->default_value(ganak_path),
+      "Exact counter binary used by --exact-f and --exact-g")(
+      "ganak-timeout",
+      po::value(&ganak_timeout)->default_value(ganak_timeout),
+      "Wall-clock seconds per exact count before it is killed and redone "
+      "with ApproxMC (0: no limit)")(
+      "ganak-mem",
+      po::value(&ganak_mem)->default_value(ganak_mem),
+      "Address-space limit in MB per exact count; running out redoes the "
+      "count with ApproxMC (0: no limit)")(
+      "ganak-procs",
+      po::value(&ganak_procs)->default_value(ganak_procs),
+      "Maximum number of exact counter processes running at once")(
       "epsilon-fc",
       po::value(&epsilon_weightage_fc)
           ->default_value(epsilon_weightage_fc, my_epsilon_weightage_fc.str()),
@@ -308,36 +448,186 @@ void add_supported_options(int argc, char** argv)
   }
 }
 
-void readInAFile(const string& filename)
+static void parse_shard()
 {
+  if (shard_spec.empty()) return;
+  char tail;
+  if (sscanf(shard_spec.c_str(), "%u/%u%c", &shard_index, &num_shards, &tail)
+          != 2
+      || num_shards == 0 || shard_index >= num_shards)
+  {
+    cerr << "ERROR: --shard wants i/n with 0 <= i < n, got '" << shard_spec
+         << "'" << endl;
+    std::exit(-1);
+  }
+  if (shard_file.empty())
+  {
+    shard_file = "skolemfc-shard-" + std::to_string(shard_index) + "-of-"
+                 + std::to_string(num_shards) + ".bin";
+  }
+}
+
+bool readInAFile(const string& filename,
+                 SklFC* counter,
+                 uint32_t threads,
+                 string& error)
+{
+  // Plain files are mapped and parsed in parallel, gzip ones are streamed
+  if (qdimacs_mappable(filename))
+    return read_qdimacs_mapped(filename, counter, threads, verbosity, error);
+
 #ifndef USE_ZLIB
   FILE* in = fopen(filename.c_str(), "rb");
   DimacsParser<StreamBuffer<FILE*, FN>, SklFC> parser(
-      skolemfc, NULL, verbosity);
+      counter, NULL, verbosity);
 #else
   gzFile in = gzopen(filename.c_str(), "rb");
   DimacsParser<StreamBuffer<gzFile, GZ>, SklFC> parser(
-      skolemfc, NULL, verbosity);
+      counter, NULL, verbosity);
 #endif
 
   if (in == NULL)
   {
-    std::cerr << "ERROR! Could not open file '" << filename
-              << "' for reading: " << strerror(errno) << endl;
-
-    std::exit(-1);
+    error = "could not open file '" + filename
+            + "' for reading: " + strerror(errno);
+    return false;
   }
 
-  if (!parser.parse_DIMACS(in, true))
-  {
-    exit(-1);
-  }
+  const bool ok = parser.parse_DIMACS(in, true);
+  if (!ok) error = "could not parse '" + filename + "'";
 
 #ifndef USE_ZLIB
   fclose(in);
 #else
   gzclose(in);
 #endif
+  return ok;
+}
+
+void configure(SklFC* counter, uint32_t threads)
+{
+  // The ordering of setting oracles are interdependent
+  // Please do not change the order
+
+  counter->set_noguarntee_mode(noguarantee);
+
+  counter->set_oracles(use_unisamp_sampling, exactcount_f, exactcount_g);
+  counter->set_persistent_count(persistent_count);
+  counter->set_residual_cache(residual_cache);
+  counter->set_exact_residual_vars(exact_residual_vars);
+  counter->set_g_counter_parameters(g_counter_epsilon, g_counter_delta);
+
+  counter->check_ready();
+  counter->set_num_threads(threads);
+  counter->set_pipeline(pipeline);
+  counter->set_mem_limit(mem_limit);
+  counter->set_decompose(decompose);
+  counter->set_sample_spill(sample_spill_dir);
+  counter->set_ganak(ganak_path, ganak_timeout, ganak_mem, ganak_procs);
+  counter->set_checkpoint(checkpoint_path, checkpoint_interval, resume);
+  counter->set_shard(shard_index, num_shards, shard_file, shard_margin);
+  counter->set_eliminate_defined(eliminate_defined, definability_confl);
+  counter->set_parameters();
+  counter->set_ignore_unsat(!count_unsat_inputs);
+  counter->set_static_samp(static_samp_est);
+  counter->set_dklr_parameters(
+      epsilon_weightage_fc, delta_weightage_fc, max_error_logcounter);
+}
+
+// One instance of a batch. The per-instance log goes to cout, which batch
+// mode points at --batch-log or nowhere.
+BatchResult count_batch_instance(const string& file, uint32_t threads)
+{
+  BatchResult r;
+  SklFC counter(epsilon, delta, seed, 0);
+  cout << "c [sklfc] batch: starting " << file << endl;
+  if (!readInAFile(file, &counter, threads, r.error)) return r;
+  configure(&counter, threads);
+  const SkolemFC::SklFCResult result = counter.run();
+
+  std::ostringstream count;
+  count << result.log2_count;
+  r.log2_count = count.str();
+  r.iterations = result.iterations;
+  switch (result.status)
+  {
+    case SkolemFC::SklFCResult::ok:
+      r.status = "ok";
+      break;
+    case SkolemFC::SklFCResult::failed:
+      r.status = "failed";
+      r.error = "model counting oracle error bound exceeded";
+      break;
+    case SkolemFC::SklFCResult::cancelled:
+      r.status = "cancelled";
+      break;
+    case SkolemFC::SklFCResult::error:
+      r.status = "error";
+      r.error = result.message;
+      break;
+  }
+  return r;
+}
+
+int run_serve_mode()
+{
+  auto warm = std::make_shared<SkolemFCInt::WarmCache>();
+  return run_server(serve_socket, [&](const string& formula) {
+    SklFC counter(epsilon, delta, seed, verbosity);
+    counter.set_warm_cache(warm);
+    string error;
+    if (!readInAFile(formula, &counter, nthreads, error))
+    {
+      cout << "e " << error << endl;
+      return;
+    }
+    configure(&counter, nthreads);
+    counter.count();
+    if (counter.failed())
+      cout << "e counting failed, see the log above" << endl;
+  });
+}
+
+int run_batch_mode()
+{
+  // Only the result lines go to stdout. Jobs log through cout at the same
+  // time, so the log file is only written through a SyncLogBuf.
+  std::ofstream log_file;
+  if (!batch_log.empty()) log_file.open(batch_log);
+  SyncLogBuf log_buf(log_file.is_open() ? log_file.rdbuf() : nullptr);
+  std::streambuf* orig = cout.rdbuf(&log_buf);
+
+  BatchOptions opts;
+  opts.inputs = batch_inputs;
+  opts.jobs = batch_jobs > 0 ? batch_jobs : nthreads;
+  opts.mem_limit = batch_mem;
+  opts.out = batch_out;
+  const uint32_t threads = std::max<uint32_t>(1, nthreads / opts.jobs);
+  const uint32_t not_ok = run_batch(opts, [&](const string& file) {
+    return count_batch_instance(file, threads);
+  });
+
+  cout.flush();
+  cout.rdbuf(orig);
+  return not_ok == 0 ? 0 : 1;
+}
+
+void start_profiling()
+{
+  if (stats_json.empty() && trace_file.empty()) return;
+  SkolemFCInt::Profiler& prof = SkolemFCInt::Profiler::get();
+  prof.enable(!trace_file.empty());
+  prof.name_thread("main");
+}
+
+int finish_profiling(int ret)
+{
+  SkolemFCInt::Profiler& prof = SkolemFCInt::Profiler::get();
+  if (!stats_json.empty() && !prof.write_stats_json(stats_json))
+    std::cerr << "ERROR: cannot write " << stats_json << endl;
+  if (!trace_file.empty() && !prof.write_trace(trace_file))
+    std::cerr << "ERROR: cannot write " << trace_file << endl;
+  return ret;
 }
 
 int main(int argc, char** argv)
@@ -358,6 +648,10 @@ int main(int argc, char** argv)
     }
   }
   add_supported_options(argc, argv);
+  parse_shard();
+  start_profiling();
+  if (!batch_inputs.empty()) return finish_profiling(run_batch_mode());
+  if (!serve_socket.empty()) return finish_profiling(run_serve_mode());
 
   skolemfc = new SkolemFC::SklFC(epsilon, delta, seed, verbosity);
 
@@ -374,7 +668,8 @@ int main(int argc, char** argv)
 
   cout << "c [sklfc] executed with command line: " << command_line << endl;
 
-  double starTime = cpuTime();
+  const double start_wall = wallTime();
+  const double start_cpu = cpuTimeTotal();
   cout << "c [sklfc] using epsilon: " << epsilon << " delta: " << delta
        << " seed: " << seed << endl;
 
@@ -385,23 +680,14 @@ int main(int argc, char** argv)
     exit(-1);
   }
   const string inp = vm["input"].as<string>();
-  readInAFile(inp);
-
-  // The ordering of setting oracles are interdependent
-  // Please do not change the order
-
-  skolemfc->set_noguarntee_mode(noguarantee);
-
-  skolemfc->set_oracles(use_unisamp_sampling, exactcount_f, exactcount_g);
-  skolemfc->set_g_counter_parameters(g_counter_epsilon, g_counter_delta);
+  string error;
+  if (!readInAFile(inp, skolemfc, nthreads, error))
+  {
+    std::cerr << "ERROR! " << error << endl;
+    std::exit(-1);
+  }
 
-  skolemfc->check_ready();
-  skolemfc->set_num_threads(nthreads);
-  skolemfc->set_parameters();
-  skolemfc->set_ignore_unsat(!count_unsat_inputs);
-  skolemfc->set_static_samp(static_samp_est);
-  skolemfc->set_dklr_parameters(
-      epsilon_weightage_fc, delta_weightage_fc, max_error_logcounter);
+  configure(skolemfc, nthreads);
 
   skolemfc->count();
 
@@ -409,9 +695,13 @@ int main(int argc, char** argv)
           "---------------------------------------------------------\nc\n";
 
   cout << "c [sklfc] finished T: " << std::setprecision(2) << std::fixed
-       << (cpuTime() - starTime) << endl;
+       << (wallTime() - start_wall) << endl;
+  cout << "c [sklfc] CPU T: " << (cpuTimeTotal() - start_cpu)
+       << " over all threads" << endl;
+  cout << "c [sklfc] peak memory: " << memUsedPeak() / (1024 * 1024) << " MB"
+       << endl;
   cout << "c [sklfc] iterations: " << skolemfc->get_iteration() << endl;
 
   delete skolemfc;
-  return 0;
+  return finish_profiling(0);
 }
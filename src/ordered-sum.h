@@ -0,0 +1,182 @@
+/******************************************
+ SkolemFC
+
+ Copyright (C) 2024, Arijit Shaw, Brendan Juba, and Kuldeep S. Meel.
+
+ All rights reserved.
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+***********************************************/
+
+#pragma once
+
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "skolemfc-int.h"
+
+namespace SkolemFCInt {
+
+// Per-sample log counts, summed strictly in sample-index order. Workers store
+// results in any order without locking; whoever manages to grab the reducer
+// walks the finished prefix. The stopping iteration and the sum are thus the
+// same for one thread and for many, down to the last bit.
+class OrderedSum
+{
+ public:
+  explicit OrderedSum(double _thresh) : thresh(_thresh)
+  {
+    dir.reset(new std::atomic<std::atomic<double>*>[max_chunks]);
+    for (uint64_t i = 0; i < max_chunks; i++) dir[i] = nullptr;
+  }
+  ~OrderedSum()
+  {
+    for (uint64_t i = 0; i < max_chunks; i++) delete[] dir[i].load();
+  }
+
+  void set(uint64_t index, double logcount)
+  {
+    slot(index).store(logcount, std::memory_order_release);
+  }
+  // Index that never got a sample, e.g. the tail of a short sampling round
+  void skip(uint64_t index) { set(index, -1); }
+
+  // Returns whether the threshold has been crossed. With block set the caller
+  // waits for the reducer, otherwise it leaves the work to whoever holds it.
+  bool advance(bool block = false)
+  {
+    std::unique_lock<std::mutex> lock(reduce_lock, std::defer_lock);
+    if (block)
+      lock.lock();
+    else if (!lock.try_lock())
+      return reached();
+
+    while (!crossed.load(std::memory_order_relaxed))
+    {
+      double v = slot(next).load(std::memory_order_acquire);
+      if (std::isnan(v)) break;
+      next++;
+      if (v < 0) continue;
+      prefix_sum += v;
+      prefix_count++;
+      if (prefix_sum > thresh) crossed.store(true, std::memory_order_release);
+    }
+    count_seen.store(prefix_count, std::memory_order_release);
+    sum_seen.store(prefix_sum, std::memory_order_release);
+    return reached();
+  }
+
+  // Whether index already has a result (or was skipped)
+  bool has(uint64_t index)
+  {
+    return !std::isnan(slot(index).load(std::memory_order_acquire));
+  }
+
+  // The reduced prefix and every result stored past it below end, taken
+  // under the reducer lock so it is consistent. Workers keep storing
+  // results meanwhile; the few that finish during the copy are simply
+  // counted again after a resume.
+  struct Snapshot
+  {
+    uint64_t next = 0;
+    uint64_t count = 0;
+    double sum = 0;
+    std::vector<std::pair<uint64_t, double>> pending;
+  };
+  Snapshot snapshot(uint64_t end)
+  {
+    std::lock_guard<std::mutex> lock(reduce_lock);
+    Snapshot snap;
+    snap.next = next;
+    snap.count = prefix_count;
+    snap.sum = prefix_sum;
+    snap.pending = results(next, end);
+    return snap;
+  }
+  // Every stored result, skipped indices included, in [begin, end)
+  std::vector<std::pair<uint64_t, double>> results(uint64_t begin,
+                                                   uint64_t end)
+  {
+    std::vector<std::pair<uint64_t, double>> out;
+    for (uint64_t i = begin; i < end; i++)
+    {
+      double v = slot(i).load(std::memory_order_acquire);
+      if (!std::isnan(v)) out.emplace_back(i, v);
+    }
+    return out;
+  }
+  // Only before any result of this run is stored
+  void restore(const Snapshot& snap)
+  {
+    std::lock_guard<std::mutex> lock(reduce_lock);
+    next = snap.next;
+    prefix_count = snap.count;
+    prefix_sum = snap.sum;
+    crossed.store(prefix_sum > thresh, std::memory_order_release);
+    count_seen.store(prefix_count, std::memory_order_release);
+    sum_seen.store(prefix_sum, std::memory_order_release);
+    for (const auto& p : snap.pending) set(p.first, p.second);
+  }
+
+  bool reached() const { return crossed.load(std::memory_order_acquire); }
+  uint64_t count() const { return count_seen.load(std::memory_order_acquire); }
+  double sum() const { return sum_seen.load(std::memory_order_acquire); }
+
+ private:
+  static constexpr uint64_t chunk_bits = 12;
+  static constexpr uint64_t chunk_size = 1ULL << chunk_bits;
+  static constexpr uint64_t max_chunks = 1ULL << 16;
+
+  std::atomic<double>& slot(uint64_t index)
+  {
+    uint64_t c = index >> chunk_bits;
+    release_assert(c < max_chunks);
+    std::atomic<double>* chunk = dir[c].load(std::memory_order_acquire);
+    if (chunk == nullptr)
+    {
+      std::atomic<double>* fresh = new std::atomic<double>[chunk_size];
+      for (uint64_t i = 0; i < chunk_size; i++)
+        fresh[i].store(std::numeric_limits<double>::quiet_NaN(),
+                       std::memory_order_relaxed);
+      if (dir[c].compare_exchange_strong(chunk, fresh))
+        chunk = fresh;
+      else
+        delete[] fresh;
+    }
+    return chunk[index & (chunk_size - 1)];
+  }
+
+  const double thresh;
+  std::unique_ptr<std::atomic<std::atomic<double>*>[]> dir;
+  std::mutex reduce_lock;
+  uint64_t next = 0;  // protected by reduce_lock
+  uint64_t prefix_count = 0;
+  double prefix_sum = 0;
+  std::atomic<bool> crossed{false};
+  std::atomic<uint64_t> count_seen{0};
+  std::atomic<double> sum_seen{0};
+};
+
+}  // namespace SkolemFCInt
@@ -0,0 +1,205 @@
+/******************************************
+ SkolemFC
+
+ Copyright (C) 2024, Arijit Shaw, Brendan Juba, and Kuldeep S. Meel.
+
+ All rights reserved.
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+***********************************************/
+
+#include "phase-graph.h"
+
+#include <iomanip>
+
+#include "profile.h"
+#include "time_mem.h"
+
+using namespace SkolemFCInt;
+
+double PhaseGraph::now() const
+{
+  return std::chrono::duration<double>(std::chrono::steady_clock::now()
+                                       - origin)
+      .count();
+}
+
+PhaseGraph::Id PhaseGraph::add(const std::string& name,
+                               std::function<void()> fn,
+                               const std::vector<Id>& deps)
+{
+  std::lock_guard<std::mutex> guard(lock);
+  const Id id = phases.size();
+  phases.emplace_back(new Phase);
+  Phase& ph = *phases.back();
+  ph.name = name;
+  ph.fn = std::move(fn);
+  ph.deps = deps;
+  for (Id d : deps)
+  {
+    phases[d]->dependents.push_back(id);
+    if (!phases[d]->done) ph.remaining++;
+  }
+  return id;
+}
+
+void PhaseGraph::run(Id id)
+{
+  Phase& ph = *phases[id];
+  // A phase whose input failed is skipped and fails the same way
+  std::exception_ptr error;
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    for (Id d : ph.deps)
+      if (phases[d]->error) error = phases[d]->error;
+  }
+  const double start = now();
+  if (!error)
+  {
+    Profiler& prof = Profiler::get();
+    if (concurrent) prof.name_thread("phase " + ph.name);
+    ProfileScope span(prof.enabled() ? prof.intern("phase " + ph.name)
+                                     : (uint32_t)Probe::other);
+    try
+    {
+      ph.fn();
+    }
+    catch (...)
+    {
+      error = std::current_exception();
+    }
+  }
+  const double end = now();
+  const uint64_t rss = memUsedRss();
+  const uint64_t peak_rss = memUsedPeak();
+
+  std::lock_guard<std::mutex> guard(lock);
+  ph.start = start;
+  ph.end = end;
+  ph.rss = rss;
+  ph.peak_rss = peak_rss;
+  ph.error = error;
+  ph.done = true;
+  for (Id d : ph.dependents)
+  {
+    Phase& dep = *phases[d];
+    if (--dep.remaining == 0 && concurrent) launch(d);
+  }
+  finished.notify_all();
+}
+
+void PhaseGraph::launch(Id id)
+{
+  Phase& ph = *phases[id];
+  if (ph.launched) return;
+  ph.launched = true;
+  ph.thread = std::thread([this, id]() { run(id); });
+}
+
+void PhaseGraph::start()
+{
+  if (!concurrent) return;
+  std::lock_guard<std::mutex> guard(lock);
+  started = true;
+  for (Id id = 0; id < phases.size(); id++)
+    if (phases[id]->remaining == 0) launch(id);
+}
+
+void PhaseGraph::wait(Id id)
+{
+  if (!concurrent)
+  {
+    // Everything added before id may be a dependency, run it in order
+    for (Id i = 0; i <= id; i++)
+    {
+      if (phases[i]->launched) continue;
+      phases[i]->launched = true;
+      run(i);
+    }
+  }
+  else
+  {
+    if (!started) start();
+    std::unique_lock<std::mutex> guard(lock);
+    finished.wait(guard, [&]() { return phases[id]->done; });
+  }
+  if (phases[id]->error) std::rethrow_exception(phases[id]->error);
+}
+
+void PhaseGraph::join_all()
+{
+  for (Id id = 0; id < phases.size(); id++)
+  {
+    if (!phases[id]->launched && !concurrent)
+    {
+      phases[id]->launched = true;
+      run(id);
+    }
+    if (concurrent)
+    {
+      if (!started) start();
+      std::unique_lock<std::mutex> guard(lock);
+      finished.wait(guard, [&]() { return phases[id]->done; });
+    }
+    if (phases[id]->thread.joinable()) phases[id]->thread.join();
+  }
+}
+
+void PhaseGraph::wait_all()
+{
+  join_all();
+  for (const auto& ph : phases)
+    if (ph->error) std::rethrow_exception(ph->error);
+}
+
+void PhaseGraph::print(std::ostream& out) const
+{
+  Id last = 0;
+  for (Id id = 0; id < phases.size(); id++)
+  {
+    const Phase& ph = *phases[id];
+    if (!ph.done) continue;
+    out << "c [sklfc] phase " << std::left << std::setw(12) << ph.name
+        << std::right << std::setprecision(2) << std::fixed << " start "
+        << std::setw(8) << ph.start << " end " << std::setw(8) << ph.end
+        << " (" << ph.end - ph.start << " s) rss "
+        << ph.rss / (1024 * 1024) << " MB peak "
+        << ph.peak_rss / (1024 * 1024) << " MB" << std::endl;
+    if (ph.end > phases[last]->end) last = id;
+  }
+  if (phases.empty() || !phases[last]->done) return;
+
+  // Walk back through the dependency that finished last at every step. Run
+  // inline, every phase waited for the one before it.
+  std::vector<Id> path{last};
+  while (!concurrent && path.back() > 0) path.push_back(path.back() - 1);
+  while (concurrent && !phases[path.back()]->deps.empty())
+  {
+    const Phase& ph = *phases[path.back()];
+    Id pred = ph.deps[0];
+    for (Id d : ph.deps)
+      if (phases[d]->end > phases[pred]->end) pred = d;
+    path.push_back(pred);
+  }
+  out << "c [sklfc] startup critical path:";
+  for (size_t i = path.size(); i-- > 0;)
+    out << (i + 1 == path.size() ? " " : " -> ") << phases[path[i]]->name;
+  out << " (" << std::setprecision(2) << std::fixed << phases[last]->end
+      << " s)" << std::endl;
+}
@@ -0,0 +1,103 @@
+/******************************************
+ SkolemFC
+
+ Copyright (C) 2024, Arijit Shaw, Brendan Juba, and Kuldeep S. Meel.
+
+ All rights reserved.
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+***********************************************/
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace SkolemFCInt {
+
+// Startup phases and what they depend on. Once started, every phase runs on
+// its own thread as soon as its dependencies finish; wait() blocks for one
+// phase, so the caller can move on while independent phases keep running.
+// Sequential graphs run phases inline, in the order they were added, when
+// they are first waited for. A phase that throws fails the phases depending
+// on it, and waiting for any of them rethrows the exception. The pool is not
+// used: its wait() and cancel() cover every queued task and belong to the
+// counting loop.
+class PhaseGraph
+{
+ public:
+  typedef uint32_t Id;
+
+  explicit PhaseGraph(bool _concurrent)
+      : concurrent(_concurrent), origin(std::chrono::steady_clock::now())
+  {
+  }
+  ~PhaseGraph() { join_all(); }
+
+  // Dependencies must have been added before
+  Id add(const std::string& name,
+         std::function<void()> fn,
+         const std::vector<Id>& deps = {});
+  void start();
+  void wait(Id id);
+  void wait_all();
+
+  // Per-phase wall-clock times, the process RSS and its peak so far when each
+  // phase ended, and the chain of phases that ended last
+  void print(std::ostream& out) const;
+
+ private:
+  struct Phase
+  {
+    std::string name;
+    std::function<void()> fn;
+    std::vector<Id> deps;
+    std::vector<Id> dependents;
+    uint32_t remaining = 0;
+    bool launched = false;
+    bool done = false;
+    std::exception_ptr error;
+    double start = 0, end = 0;
+    uint64_t rss = 0, peak_rss = 0;
+    std::thread thread;
+  };
+
+  double now() const;
+  void run(Id id);
+  void launch(Id id);  // lock held
+  void join_all();
+
+  bool concurrent;
+  bool started = false;
+  std::chrono::steady_clock::time_point origin;
+  std::vector<std::unique_ptr<Phase>> phases;
+  std::mutex lock;
+  std::condition_variable finished;
+};
+
+}  // namespace SkolemFCInt
@@ -0,0 +1,336 @@
+/******************************************
+ SkolemFC
+
+ Copyright (C) 2024, Arijit Shaw, Brendan Juba, and Kuldeep S. Meel.
+
+ All rights reserved.
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+***********************************************/
+
+#include "profile.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <vector>
+
+#include "json-escape.h"
+#include "time_mem.h"
+
+using namespace SkolemFCInt;
+
+namespace {
+
+const char* const probe_names[] = {"arjun-simp",
+                                   "approxmc",
+                                   "unigen-prep",
+                                   "unigen-sample",
+                                   "cms-solve",
+                                   "g-formula",
+                                   "engine-restrict",
+                                   "exact-enum",
+                                   "residual-lookup",
+                                   "ganak-write",
+                                   "ganak-spawn",
+                                   "ganak-run",
+                                   "lock-wait",
+                                   "queue-full",
+                                   "mem-wait",
+                                   "other"};
+static_assert(sizeof(probe_names) / sizeof(probe_names[0])
+                  == (size_t)Probe::num_probes,
+              "every probe needs a name");
+
+// Durations in buckets of a quarter octave from 64 ns up, so percentiles
+// are within 19% whatever the scale
+const uint32_t num_buckets = 4 * 32;
+
+uint32_t bucket_of(uint64_t ns)
+{
+  if (ns < 64) return 0;
+  const uint32_t octave = 63 - __builtin_clzll(ns);
+  const uint32_t sub = (ns >> (octave - 2)) & 3;
+  return std::min(num_buckets - 1, (octave - 6) * 4 + sub);
+}
+
+double bucket_mid_ns(uint32_t b)
+{
+  const uint32_t octave = b / 4 + 6, sub = b % 4;
+  const double width = (double)(1ULL << (octave - 2));
+  return (4 + sub) * width + width / 2;
+}
+
+// Written by the owning thread only, read when the stats are written out
+struct SpanStats
+{
+  std::atomic<uint64_t> count{0}, total_ns{0}, max_ns{0}, bytes{0};
+  std::array<std::atomic<uint64_t>, num_buckets> buckets{};
+
+  static void bump(std::atomic<uint64_t>& a, uint64_t by)
+  {
+    a.store(a.load(std::memory_order_relaxed) + by,
+            std::memory_order_relaxed);
+  }
+};
+
+struct Event
+{
+  uint64_t start_ns, dur_ns;
+  uint32_t span;
+};
+
+struct ThreadLog
+{
+  uint32_t tid = 0;
+  std::array<std::atomic<SpanStats*>, Profiler::max_spans> spans{};
+  std::mutex events_lock;
+  std::vector<Event> events;
+  uint64_t dropped = 0;
+
+  ~ThreadLog()
+  {
+    for (auto& s : spans) delete s.load();
+  }
+};
+
+struct Registry
+{
+  std::mutex lock;
+  std::vector<std::string> names;
+  std::vector<std::string> thread_names;
+  std::vector<std::shared_ptr<ThreadLog>> logs;
+  uint64_t origin_ns = 0;
+};
+
+Registry& registry()
+{
+  static Registry r;
+  return r;
+}
+
+thread_local std::shared_ptr<ThreadLog> this_thread_log;
+
+ThreadLog& thread_log()
+{
+  if (!this_thread_log)
+  {
+    auto log = std::make_shared<ThreadLog>();
+    Registry& r = registry();
+    std::lock_guard<std::mutex> guard(r.lock);
+    log->tid = r.logs.size();
+    r.logs.push_back(log);
+    r.thread_names.push_back("thread " + std::to_string(log->tid));
+    this_thread_log = log;
+  }
+  return *this_thread_log;
+}
+
+// Per-span totals over every thread
+struct Merged
+{
+  uint64_t count = 0, total_ns = 0, max_ns = 0, bytes = 0;
+  std::array<uint64_t, num_buckets> buckets{};
+
+  double percentile_us(double q) const
+  {
+    const uint64_t rank = (uint64_t)(q * (double)(count - 1));
+    uint64_t seen = 0;
+    for (uint32_t b = 0; b < num_buckets; b++)
+    {
+      seen += buckets[b];
+      if (seen > rank) return std::min(bucket_mid_ns(b), (double)max_ns) / 1e3;
+    }
+    return max_ns / 1e3;
+  }
+};
+
+}  // namespace
+
+Profiler::Profiler()
+{
+  Registry& r = registry();
+  for (const char* name : probe_names) r.names.push_back(name);
+}
+
+Profiler& Profiler::get()
+{
+  static Profiler profiler;
+  return profiler;
+}
+
+void Profiler::enable(bool _trace)
+{
+  {
+    std::lock_guard<std::mutex> guard(registry().lock);
+    registry().origin_ns = now_ns();
+    trace.store(_trace, std::memory_order_relaxed);
+  }
+  on.store(true, std::memory_order_release);
+}
+
+uint64_t Profiler::now_ns() const
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+uint32_t Profiler::intern(const std::string& name)
+{
+  Registry& r = registry();
+  std::lock_guard<std::mutex> guard(r.lock);
+  for (uint32_t i = 0; i < r.names.size(); i++)
+    if (r.names[i] == name) return i;
+  if (r.names.size() == max_spans) return (uint32_t)Probe::other;
+  r.names.push_back(name);
+  return r.names.size() - 1;
+}
+
+void Profiler::name_thread(const std::string& name)
+{
+  if (!enabled()) return;
+  const uint32_t tid = thread_log().tid;
+  std::lock_guard<std::mutex> guard(registry().lock);
+  registry().thread_names[tid] = name;
+}
+
+void Profiler::record(uint32_t span,
+                      uint64_t start_ns,
+                      uint64_t end_ns,
+                      uint64_t bytes)
+{
+  ThreadLog& log = thread_log();
+  SpanStats* stats = log.spans[span].load(std::memory_order_acquire);
+  if (stats == nullptr)
+  {
+    stats = new SpanStats;
+    log.spans[span].store(stats, std::memory_order_release);
+  }
+  const uint64_t dur = end_ns - start_ns;
+  SpanStats::bump(stats->count, 1);
+  SpanStats::bump(stats->total_ns, dur);
+  SpanStats::bump(stats->bytes, bytes);
+  SpanStats::bump(stats->buckets[bucket_of(dur)], 1);
+  if (dur > stats->max_ns.load(std::memory_order_relaxed))
+    stats->max_ns.store(dur, std::memory_order_relaxed);
+
+  if (!trace.load(std::memory_order_relaxed)) return;
+  std::lock_guard<std::mutex> guard(log.events_lock);
+  if (log.events.size() < max_events_per_thread)
+    log.events.push_back(Event{start_ns, dur, span});
+  else
+    log.dropped++;
+}
+
+bool Profiler::write_stats_json(const std::string& path) const
+{
+  Registry& r = registry();
+  std::lock_guard<std::mutex> guard(r.lock);
+
+  std::vector<Merged> merged(r.names.size());
+  uint64_t dropped = 0;
+  for (const auto& log : r.logs)
+  {
+    for (uint32_t s = 0; s < merged.size(); s++)
+    {
+      const SpanStats* stats = log->spans[s].load(std::memory_order_acquire);
+      if (stats == nullptr) continue;
+      Merged& m = merged[s];
+      m.count += stats->count.load(std::memory_order_relaxed);
+      m.total_ns += stats->total_ns.load(std::memory_order_relaxed);
+      m.bytes += stats->bytes.load(std::memory_order_relaxed);
+      m.max_ns = std::max(m.max_ns, stats->max_ns.load());
+      for (uint32_t b = 0; b < num_buckets; b++)
+        m.buckets[b] += stats->buckets[b].load(std::memory_order_relaxed);
+    }
+    std::lock_guard<std::mutex> events_guard(log->events_lock);
+    dropped += log->dropped;
+  }
+
+  std::vector<uint32_t> order;
+  for (uint32_t s = 0; s < merged.size(); s++)
+    if (merged[s].count > 0) order.push_back(s);
+  std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+    return merged[a].total_ns > merged[b].total_ns;
+  });
+
+  std::ofstream out(path);
+  if (!out) return false;
+  out << std::fixed << std::setprecision(3);
+  out << "{\n  \"wall_seconds\": " << (now_ns() - r.origin_ns) / 1e9
+      << ",\n  \"cpu_seconds\": " << cpuTimeTotal()
+      << ",\n  \"peak_rss_bytes\": " << memUsedPeak()
+      << ",\n  \"threads\": " << r.logs.size()
+      << ",\n  \"trace_events_dropped\": " << dropped
+      << ",\n  \"spans\": [";
+  for (size_t i = 0; i < order.size(); i++)
+  {
+    const Merged& m = merged[order[i]];
+    out << (i == 0 ? "\n" : ",\n") << "    {\"name\": \""
+        << json_escape(r.names[order[i]]) << "\", \"count\": " << m.count
+        << ", \"total_seconds\": " << m.total_ns / 1e9
+        << ", \"mean_us\": " << m.total_ns / 1e3 / m.count
+        << ", \"p50_us\": " << m.percentile_us(0.5)
+        << ", \"p99_us\": " << m.percentile_us(0.99)
+        << ", \"max_us\": " << m.max_ns / 1e3 << ", \"bytes\": " << m.bytes
+        << "}";
+  }
+  out << "\n  ]\n}\n";
+  return (bool)out;
+}
+
+bool Profiler::write_trace(const std::string& path) const
+{
+  Registry& r = registry();
+  std::lock_guard<std::mutex> guard(r.lock);
+
+  std::ofstream out(path);
+  if (!out) return false;
+  out << std::fixed << std::setprecision(3);
+  out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+  bool first = true;
+  auto sep = [&]() -> const char* {
+    const char* s = first ? "" : ",\n";
+    first = false;
+    return s;
+  };
+  for (const auto& log : r.logs)
+  {
+    out << sep() << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, "
+        << "\"tid\": " << log->tid << ", \"args\": {\"name\": \""
+        << json_escape(r.thread_names[log->tid]) << "\"}}";
+    std::lock_guard<std::mutex> events_guard(log->events_lock);
+    for (const Event& e : log->events)
+    {
+      // Spans from before enable() have nothing to line up with
+      if (e.start_ns < r.origin_ns) continue;
+      out << sep() << "{\"name\": \"" << json_escape(r.names[e.span])
+          << "\", \"cat\": \"skolemfc\", \"ph\": \"X\", \"pid\": 1, "
+          << "\"tid\": " << log->tid
+          << ", \"ts\": " << (e.start_ns - r.origin_ns) / 1e3
+          << ", \"dur\": " << e.dur_ns / 1e3 << "}";
+    }
+  }
+  out << "\n]}\n";
+  return (bool)out;
+}
@@ -0,0 +1,134 @@
+/******************************************
+ SkolemFC
+
+ Copyright (C) 2024, Arijit Shaw, Brendan Juba, and Kuldeep S. Meel.
+
+ All rights reserved.
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+***********************************************/
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+namespace SkolemFCInt {
+
+// Spans worth timing on their own. Startup phases get names of their own at
+// run time, after these.
+enum class Probe : uint32_t
+{
+  arjun_simp,       // loading a formula into Arjun and simplifying it
+  approxmc,         // ApproxMC on the simplified formula
+  unigen_prep,      // simplifying G and counting it for UniGen
+  unigen_sample,    // drawing the samples of one round
+  cms_solve,        // CryptoMiniSat calls outside the oracles
+  g_formula,        // building G
+  engine_restrict,  // copying F restricted to a sample
+  exact_enum,       // enumerating a small residual
+  residual_lookup,  // canonicalizing a residual and looking it up
+  ganak_write,      // serializing a CNF for Ganak
+  ganak_spawn,      // fork() of a Ganak process
+  ganak_run,        // waiting for Ganak's answer
+  lock_wait,        // contended locks
+  queue_full,       // samplers waiting on a full sample queue
+  mem_wait,         // workers parked by --mem-limit
+  other,            // names past max_spans
+  num_probes
+};
+
+// Process-wide span recorder, off unless enabled. Every thread records into
+// its own log, so a span costs two clock reads and no lock; the logs are
+// merged when written out. With tracing on, spans are also kept one by one
+// for a Chrome trace, one track per thread.
+class Profiler
+{
+ public:
+  static const uint32_t max_spans = 64;
+  static const uint64_t max_events_per_thread = 1 << 20;
+
+  static Profiler& get();
+
+  void enable(bool trace);
+  bool enabled() const { return on.load(std::memory_order_relaxed); }
+  uint64_t now_ns() const;
+
+  // Span id for a name, the same for every call with that name
+  uint32_t intern(const std::string& name);
+  // Track name of the calling thread in the trace
+  void name_thread(const std::string& name);
+  void record(uint32_t span, uint64_t start_ns, uint64_t end_ns,
+              uint64_t bytes);
+
+  // Count, total, p50/p99/max and bytes per span
+  bool write_stats_json(const std::string& path) const;
+  bool write_trace(const std::string& path) const;
+
+ private:
+  Profiler();
+
+  std::atomic<bool> on{false};
+  std::atomic<bool> trace{false};
+};
+
+class ProfileScope
+{
+ public:
+  explicit ProfileScope(Probe p) : ProfileScope((uint32_t)p) {}
+  explicit ProfileScope(uint32_t _span) : span(_span)
+  {
+    Profiler& prof = Profiler::get();
+    if (prof.enabled()) start = prof.now_ns();
+  }
+  ~ProfileScope() { stop(); }
+  ProfileScope(const ProfileScope&) = delete;
+  ProfileScope& operator=(const ProfileScope&) = delete;
+
+  void add_bytes(uint64_t n) { bytes += n; }
+  void stop()
+  {
+    if (start == 0) return;
+    Profiler& prof = Profiler::get();
+    prof.record(span, start, prof.now_ns(), bytes);
+    start = 0;
+  }
+
+ private:
+  uint32_t span;
+  uint64_t start = 0;
+  uint64_t bytes = 0;
+};
+
+// Takes m, timing the wait under Probe::lock_wait if someone else holds it
+template <class M>
+std::unique_lock<M> profiled_lock(M& m)
+{
+  std::unique_lock<M> guard(m, std::try_to_lock);
+  if (!guard.owns_lock())
+  {
+    ProfileScope wait(Probe::lock_wait);
+    guard.lock();
+  }
+  return guard;
+}
+
+}  // namespace SkolemFCInt
@@ -0,0 +1,381 @@
+/******************************************
+ SkolemFC
+
+ Copyright (C) 2024, Arijit Shaw, Brendan Juba, and Kuldeep S. Meel.
+
+ All rights reserved.
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+***********************************************/
+
+#include "qdimacs-reader.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+#include "clause-arena.h"
+#include "skolemfc.h"
+#include "thread-pool.h"
+#include "time_mem.h"
+
+using namespace SkolemFC;
+using SkolemFCInt::ClauseArena;
+using std::string;
+using std::vector;
+
+namespace {
+
+// Smallest clause section worth a chunk of its own
+const size_t min_chunk_bytes = 1 << 20;
+
+// What one thread made of its chunk. Quantifier lines among the clauses
+// are accepted, as the streaming parser does, and kept in order.
+struct Chunk
+{
+  const char* begin = nullptr;
+  const char* end = nullptr;
+  ClauseArena clauses;
+  vector<uint32_t> forall_vars, exists_vars;
+  const char* error_at = nullptr;  // set on failure
+  const char* error = nullptr;
+};
+
+// Whitespace that does not end a line
+inline bool is_blank(char c)
+{
+  return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+}
+
+inline void skip_blanks(const char*& p, const char* end)
+{
+  while (p < end && is_blank(*p)) ++p;
+}
+
+inline void skip_line(const char*& p, const char* end)
+{
+  const void* nl = memchr(p, '\n', end - p);
+  p = nl ? (const char*)nl + 1 : end;
+}
+
+// One decimal integer after optional blanks, up to 2^31-1 in magnitude
+inline bool parse_int(const char*& p, const char* end, int64_t& value)
+{
+  skip_blanks(p, end);
+  const bool neg = p < end && *p == '-';
+  if (neg) ++p;
+  if (p == end || *p < '0' || *p > '9') return false;
+  int64_t v = 0;
+  while (p < end && *p >= '0' && *p <= '9')
+  {
+    v = v * 10 + (*p - '0');
+    if (v > INT32_MAX) return false;
+    ++p;
+  }
+  value = neg ? -v : v;
+  return true;
+}
+
+// Variables of an 'a' or 'e' line, p just past the letter
+const char* parse_quantifier(const char*& p,
+                             const char* end,
+                             vector<uint32_t>& vars)
+{
+  for (;;)
+  {
+    int64_t v;
+    if (!parse_int(p, end, v)) return "expected a variable or the closing 0";
+    if (v == 0) break;
+    vars.push_back(std::abs(v) - 1);
+  }
+  skip_line(p, end);
+  return nullptr;
+}
+
+// 'p cnf vars cls', p just past the 'p'
+const char* parse_header(const char*& p,
+                         const char* end,
+                         int64_t& num_vars,
+                         int64_t& num_cls)
+{
+  skip_blanks(p, end);
+  if (end - p < 3 || strncmp(p, "cnf", 3) != 0)
+    return "expected 'p cnf vars cls'";
+  p += 3;
+  if (!parse_int(p, end, num_vars) || !parse_int(p, end, num_cls))
+    return "expected the number of variables and clauses";
+  if (num_vars < 0 || num_cls < 0)
+    return "negative number of variables or clauses in the header";
+  if (num_vars > (1LL << 28)) return "far too many variables in the header";
+  skip_line(p, end);
+  return nullptr;
+}
+
+// One clause line into the arena, p at its first literal
+const char* parse_clause(const char*& p,
+                         const char* end,
+                         uint32_t num_vars,
+                         ClauseArena& clauses)
+{
+  for (;;)
+  {
+    int64_t lit;
+    if (!parse_int(p, end, lit))
+      return "expected a literal; the line must end with 0";
+    if (lit == 0) break;
+    const uint32_t var = std::abs(lit) - 1;
+    if (var >= num_vars) return "variable larger than the header told us";
+    clauses.push_lit(CMSat::Lit(var, lit < 0));
+    // DimacsParser takes only a space here, not any blank
+    if (p == end || *p != ' ')
+      return "expected a space after the literal; the line must end with 0";
+  }
+  clauses.end_clause();
+  skip_blanks(p, end);
+  if (p == end) return nullptr;
+  if (*p != '\n') return "nothing may follow the 0 that ends a clause";
+  ++p;
+  return nullptr;
+}
+
+void parse_chunk(Chunk& c, uint32_t num_vars)
+{
+  const char* p = c.begin;
+  const char* end = c.end;
+  const char* error = nullptr;
+  while (p < end && error == nullptr)
+  {
+    const char* line = p;
+    skip_blanks(p, end);
+    if (p == end) break;
+    switch (*p)
+    {
+      case '\n': ++p; break;
+      case 'c': skip_line(p, end); break;
+      case 'a': error = parse_quantifier(++p, end, c.forall_vars); break;
+      case 'e': error = parse_quantifier(++p, end, c.exists_vars); break;
+      case 'p': error = "CNF header ('p cnf vars cls') found twice"; break;
+      default: error = parse_clause(p, end, num_vars, c.clauses); break;
+    }
+    if (error) c.error_at = line;
+  }
+  c.error = error;
+}
+
+// Cuts [begin, end) into n stretches of whole lines
+vector<Chunk> split_lines(const char* begin, const char* end, size_t n)
+{
+  vector<Chunk> chunks;
+  const size_t len = end - begin;
+  const char* from = begin;
+  for (size_t i = 1; i <= n && from < end; i++)
+  {
+    const char* to = end;
+    if (i < n)
+    {
+      to = std::max(from, begin + len / n * i);
+      skip_line(to, end);
+    }
+    chunks.emplace_back();
+    chunks.back().begin = from;
+    chunks.back().end = to;
+    from = to;
+  }
+  return chunks;
+}
+
+}  // namespace
+
+bool SkolemFC::qdimacs_mappable(const string& path)
+{
+  struct stat st;
+  if (stat(path.c_str(), &st) != 0 || !S_ISREG(st.st_mode)) return false;
+  FILE* f = fopen(path.c_str(), "rb");
+  if (f == NULL) return false;
+  unsigned char magic[2] = {0, 0};
+  const size_t got = fread(magic, 1, 2, f);
+  fclose(f);
+  return got < 2 || magic[0] != 0x1f || magic[1] != 0x8b;
+}
+
+bool SkolemFC::parse_qdimacs(const char* text,
+                             size_t len,
+                             SklFC* counter,
+                             uint32_t threads,
+                             uint32_t verbosity,
+                             string& error)
+{
+  std::cout << "c\nc ---- [ parsing ] "
+               "-----------------------------------------------------------"
+               "\nc\n";
+  const double start = wallTime();
+  const char* end = text + len;
+  auto fail = [&](const char* at, const string& what) {
+    const uint64_t line = 1 + std::count(text, at, '\n');
+    error = "line " + std::to_string(line) + ": " + what;
+    return false;
+  };
+
+  // Everything up to the first clause, in order
+  bool header_found = false;
+  int64_t num_vars = 0, num_cls = 0;
+  vector<uint32_t> forall_vars, exists_vars;
+  const char* p = text;
+  const char* clauses_begin = end;
+  while (p < end)
+  {
+    const char* line = p;
+    skip_blanks(p, end);
+    if (p == end) break;
+    const char* what = nullptr;
+    switch (*p)
+    {
+      case '\n': ++p; continue;
+      case 'c': skip_line(p, end); continue;
+      case 'a': what = parse_quantifier(++p, end, forall_vars); break;
+      case 'e': what = parse_quantifier(++p, end, exists_vars); break;
+      case 'p':
+        if (header_found)
+          return fail(line, "CNF header ('p cnf vars cls') found twice");
+        header_found = true;
+        what = parse_header(++p, end, num_vars, num_cls);
+        break;
+      default: clauses_begin = line; break;
+    }
+    if (what) return fail(line, what);
+    if (clauses_begin != end) break;
+  }
+  if (clauses_begin != end && !header_found)
+    return fail(clauses_begin, "DIMACS header ('p cnf vars cls') never found");
+  if (verbosity && header_found)
+  {
+    std::cout << "c -- header says num vars:   " << std::setw(12) << num_vars
+              << std::endl;
+    std::cout << "c -- header says num clauses:" << std::setw(12) << num_cls
+              << std::endl;
+  }
+
+  const size_t section = end - clauses_begin;
+  const size_t want = std::max<size_t>(1, section / min_chunk_bytes);
+  vector<Chunk> chunks =
+      split_lines(clauses_begin, end, std::min<size_t>(threads, want));
+  if (chunks.size() == 1)
+    parse_chunk(chunks[0], num_vars);
+  else if (chunks.size() > 1)
+  {
+    SkolemFCInt::ThreadPool pool(chunks.size());
+    for (Chunk& c : chunks)
+      pool.submit([&c, num_vars](uint32_t) { parse_chunk(c, num_vars); });
+    pool.wait();
+  }
+
+  // The first error in the file is the one the streaming parser would name
+  size_t nclauses = 0, nlits = 0;
+  for (const Chunk& c : chunks)
+  {
+    if (c.error) return fail(c.error_at, c.error);
+    nclauses += c.clauses.size();
+    nlits += c.clauses.num_lits();
+  }
+
+  if (counter->nVars() < (uint32_t)num_vars)
+    counter->new_vars((uint32_t)num_vars - counter->nVars());
+  for (const Chunk& c : chunks)
+  {
+    forall_vars.insert(
+        forall_vars.end(), c.forall_vars.begin(), c.forall_vars.end());
+    exists_vars.insert(
+        exists_vars.end(), c.exists_vars.begin(), c.exists_vars.end());
+  }
+  for (uint32_t v : forall_vars) counter->add_forall_var(v);
+  for (uint32_t v : exists_vars) counter->add_exists_var(v);
+
+  if (chunks.size() == 1)
+    counter->add_clauses(std::move(chunks[0].clauses));
+  else if (chunks.size() > 1)
+  {
+    ClauseArena all;
+    all.reserve(nclauses, nlits);
+    for (Chunk& c : chunks)
+    {
+      all.append(c.clauses);
+      c.clauses = ClauseArena();  // keep the peak at one extra copy
+    }
+    counter->add_clauses(std::move(all));
+  }
+
+  if (verbosity)
+  {
+    std::cout << "c -- clauses added: " << nclauses << std::endl
+              << "c -- forall vars added: " << forall_vars.size() << std::endl
+              << "c -- exists vars added: " << exists_vars.size() << std::endl;
+  }
+  std::cout << "c [sklfc] parsed " << nclauses << " clauses in "
+            << std::max<size_t>(1, chunks.size()) << " chunks, T: "
+            << std::setprecision(2) << std::fixed << wallTime() - start
+            << std::endl;
+  return true;
+}
+
+bool SkolemFC::read_qdimacs_mapped(const string& path,
+                                   SklFC* counter,
+                                   uint32_t threads,
+                                   uint32_t verbosity,
+                                   string& error)
+{
+  const int fd = open(path.c_str(), O_RDONLY);
+  struct stat st;
+  if (fd < 0 || fstat(fd, &st) != 0)
+  {
+    error = "could not open file '" + path
+            + "' for reading: " + strerror(errno);
+    if (fd >= 0) close(fd);
+    return false;
+  }
+  const size_t len = st.st_size;
+  void* mapped = nullptr;
+  if (len > 0)
+  {
+    mapped = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mapped == MAP_FAILED)
+    {
+      error = "could not map '" + path + "': " + strerror(errno);
+      close(fd);
+      return false;
+    }
+    madvise(mapped, len, MADV_SEQUENTIAL);
+  }
+  close(fd);
+
+  const bool ok = parse_qdimacs(
+      (const char*)mapped, len, counter, threads, verbosity, error);
+  if (!ok) error = "could not parse '" + path + "', " + error;
+  if (mapped) munmap(mapped, len);
+  return ok;
+}
@@ -0,0 +1,63 @@
+/******************************************
+ SkolemFC
+
+ Copyright (C) 2024, Arijit Shaw, Brendan Juba, and Kuldeep S. Meel.
+
+ All rights reserved.
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+***********************************************/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace SkolemFC {
+
+struct SklFC;
+
+// Whether path is a regular file without the gzip magic, which
+// read_qdimacs_mapped() can take; everything else goes through the
+// streaming DimacsParser
+bool qdimacs_mappable(const std::string& path);
+
+// Parses QDIMACS text into counter, as strictly as DimacsParser with
+// strict_header. Comments, the header and the quantifier prefix are read on
+// the calling thread. The clause section is cut into chunks at line
+// boundaries, which up to `threads` threads parse into clause arenas of
+// their own; these reach counter in file order with a single
+// add_clauses(). On a parse error returns false and sets error, with the
+// line number.
+bool parse_qdimacs(const char* text,
+                   size_t len,
+                   SklFC* counter,
+                   uint32_t threads,
+                   uint32_t verbosity,
+                   std::string& error);
+
+// parse_qdimacs() on the file mapped read-only, without copying it
+bool read_qdimacs_mapped(const std::string& path,
+                         SklFC* counter,
+                         uint32_t threads,
+                         uint32_t verbosity,
+                         std::string& error);
+
+}  // namespace SkolemFC
@@ -0,0 +1,134 @@
+/******************************************
+ SkolemFC
+
+ Copyright (C) 2024, Arijit Shaw, Brendan Juba, and Kuldeep S. Meel.
+
+ All rights reserved.
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+***********************************************/
+
+#include "residual-cache.h"
+
+#include <algorithm>
+#include <limits>
+
+#include "profile.h"
+#include "seed-stream.h"
+
+using namespace SkolemFCInt;
+
+static bool lit_less(const Lit a, const Lit b) { return a.toInt() < b.toInt(); }
+
+static bool clause_less(const ClauseRef a, const ClauseRef b)
+{
+  return std::lexicographical_compare(
+      a.begin(), a.end(), b.begin(), b.end(), lit_less);
+}
+
+static void sort_clauses(ClauseArena& clauses)
+{
+  static thread_local vector<uint32_t> order;
+  static thread_local ClauseArena sorted;
+
+  for (size_t i = 0; i < clauses.size(); i++)
+    std::sort(clauses.mutable_begin(i), clauses.mutable_end(i), lit_less);
+
+  order.resize(clauses.size());
+  for (uint32_t i = 0; i < order.size(); i++) order[i] = i;
+  std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+    return clause_less(clauses[a], clauses[b]);
+  });
+
+  sorted.clear();
+  sorted.reserve(clauses.size(), clauses.num_lits());
+  for (uint32_t at : order)
+  {
+    if (!sorted.empty() && sorted[sorted.size() - 1] == clauses[at]) continue;
+    sorted.push_back(clauses[at]);
+  }
+  std::swap(clauses, sorted);
+}
+
+uint64_t SkolemFCInt::canonicalize(Residual& r, vector<uint32_t>& var_map)
+{
+  sort_clauses(r.clauses);
+
+  const uint32_t unmapped = std::numeric_limits<uint32_t>::max();
+  var_map.assign(r.nvars, unmapped);
+  uint32_t next_var = 0;
+  for (size_t i = 0; i < r.clauses.size(); i++)
+  {
+    Lit* end = r.clauses.mutable_end(i);
+    for (Lit* l = r.clauses.mutable_begin(i); l != end; l++)
+    {
+      uint32_t& mapped = var_map[l->var()];
+      if (mapped == unmapped) mapped = next_var++;
+      *l = Lit(mapped, l->sign());
+    }
+  }
+  r.nvars = next_var;
+  sort_clauses(r.clauses);
+
+  uint64_t h = splitmix64(r.nvars);
+  for (const auto& clause : r.clauses)
+  {
+    h = splitmix64(h ^ (0xc1a05e00ULL + clause.size()));
+    for (const Lit& l : clause) h = splitmix64(h ^ l.toInt());
+  }
+  return h;
+}
+
+bool ResidualCache::lookup(uint64_t hash,
+                           const Residual& r,
+                           ApproxMC::SolCount& c)
+{
+  lookups.fetch_add(1, std::memory_order_relaxed);
+  Shard& shard = shards[hash % num_shards];
+  auto lock = profiled_lock(shard.lock);
+  auto range = shard.map.equal_range(hash);
+  for (auto it = range.first; it != range.second; ++it)
+  {
+    if (it->second.nvars == r.nvars && it->second.clauses == r.clauses)
+    {
+      c = it->second.count;
+      hits.fetch_add(1, std::memory_order_relaxed);
+      return true;
+    }
+  }
+  return false;
+}
+
+void ResidualCache::insert(uint64_t hash,
+                           const Residual& r,
+                           const ApproxMC::SolCount& c)
+{
+  if (entries.load(std::memory_order_relaxed) >= max_entries) return;
+
+  Shard& shard = shards[hash % num_shards];
+  auto lock = profiled_lock(shard.lock);
+  auto range = shard.map.equal_range(hash);
+  for (auto it = range.first; it != range.second; ++it)
+  {
+    if (it->second.nvars == r.nvars && it->second.clauses == r.clauses)
+      return;
+  }
+  shard.map.emplace(hash, Entry{r.nvars, r.clauses, c});
+  entries.fetch_add(1, std::memory_order_relaxed);
+}
@@ -0,0 +1,84 @@
+/******************************************
+ SkolemFC
+
+ Copyright (C) 2024, Arijit Shaw, Brendan Juba, and Kuldeep S. Meel.
+
+ All rights reserved.
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+***********************************************/
+
+#pragma once
+
+#include <approxmc/approxmc.h>
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "count-engine.h"
+
+namespace SkolemFCInt {
+
+// Brings a residual to a canonical form: literals sorted within clauses,
+// clauses sorted and deduplicated, variables renumbered by first occurrence.
+// Returns a 64-bit hash of the result.
+uint64_t canonicalize(Residual& r, vector<uint32_t>& var_map);
+
+// Concurrent map from canonical residuals to their model counts. Many X
+// assignments leave the same residual once propagated through F, and every
+// hit saves a whole oracle call. Entries are spread over independently
+// locked shards; the full clause list is kept to rule out hash collisions.
+class ResidualCache
+{
+ public:
+  explicit ResidualCache(uint64_t _max_entries = 1ULL << 20)
+      : max_entries(_max_entries)
+  {
+  }
+
+  bool lookup(uint64_t hash, const Residual& r, ApproxMC::SolCount& c);
+  void insert(uint64_t hash, const Residual& r, const ApproxMC::SolCount& c);
+
+  std::atomic<uint64_t> lookups{0};
+  std::atomic<uint64_t> hits{0};
+  std::atomic<double> miss_oracle_time{0};
+
+ private:
+  struct Entry
+  {
+    uint32_t nvars;
+    ClauseArena clauses;
+    ApproxMC::SolCount count;
+  };
+  struct Shard
+  {
+    std::mutex lock;
+    std::unordered_multimap<uint64_t, Entry> map;
+  };
+  static constexpr uint32_t num_shards = 64;
+
+  Shard shards[num_shards];
+  const uint64_t max_entries;
+  std::atomic<uint64_t> entries{0};
+};
+
+}  // namespace SkolemFCInt
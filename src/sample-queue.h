@@ -0,0 +1,145 @@
+/******************************************
+ SkolemFC
+
+ Copyright (C) 2024, Arijit Shaw, Brendan Juba, and Kuldeep S. Meel.
+
+ All rights reserved.
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+***********************************************/
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace SkolemFCInt {
+
+// A packed sample (see SampleLayout) together with its position in the
+// global sample sequence
+struct IndexedSample
+{
+  uint64_t index = 0;
+  std::vector<uint64_t> bits;
+};
+
+// Bounded multi-producer multi-consumer queue after D. Vyukov. Every cell
+// carries a sequence number telling producers and consumers whose turn it is,
+// so push and pop are a single CAS on the respective position in the common
+// case and no thread ever waits on a lock held by another.
+template <typename T>
+class SampleQueue
+{
+ public:
+  explicit SampleQueue(size_t capacity)
+  {
+    size_t cap = 2;
+    while (cap < capacity) cap <<= 1;
+    mask = cap - 1;
+    cells.reset(new Cell[cap]);
+    for (size_t i = 0; i < cap; i++)
+      cells[i].seq.store(i, std::memory_order_relaxed);
+  }
+
+  // Moves from v only when the push succeeds
+  bool try_push(T& v)
+  {
+    Cell* cell;
+    size_t pos = enqueue_pos.load(std::memory_order_relaxed);
+    for (;;)
+    {
+      cell = &cells[pos & mask];
+      size_t seq = cell->seq.load(std::memory_order_acquire);
+      intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+      if (diff == 0)
+      {
+        if (enqueue_pos.compare_exchange_weak(
+                pos, pos + 1, std::memory_order_relaxed))
+          break;
+      }
+      else if (diff < 0)
+        return false;  // full
+      else
+        pos = enqueue_pos.load(std::memory_order_relaxed);
+    }
+    cell->data = std::move(v);
+    cell->seq.store(pos + 1, std::memory_order_release);
+    return true;
+  }
+
+  bool try_pop(T& v)
+  {
+    Cell* cell;
+    size_t pos = dequeue_pos.load(std::memory_order_relaxed);
+    for (;;)
+    {
+      cell = &cells[pos & mask];
+      size_t seq = cell->seq.load(std::memory_order_acquire);
+      intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+      if (diff == 0)
+      {
+        if (dequeue_pos.compare_exchange_weak(
+                pos, pos + 1, std::memory_order_relaxed))
+          break;
+      }
+      else if (diff < 0)
+        return false;  // empty
+      else
+        pos = dequeue_pos.load(std::memory_order_relaxed);
+    }
+    v = std::move(cell->data);
+    cell->seq.store(pos + mask + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Approximate under concurrent access, which is all the scheduler needs
+  size_t size() const
+  {
+    size_t enq = enqueue_pos.load(std::memory_order_relaxed);
+    size_t deq = dequeue_pos.load(std::memory_order_relaxed);
+    return enq > deq ? enq - deq : 0;
+  }
+  size_t capacity() const { return mask + 1; }
+
+  void clear()
+  {
+    T dummy;
+    while (try_pop(dummy))
+    {
+    }
+  }
+
+ private:
+  struct Cell
+  {
+    std::atomic<size_t> seq;
+    T data;
+  };
+
+  std::unique_ptr<Cell[]> cells;
+  size_t mask = 0;
+  alignas(64) std::atomic<size_t> enqueue_pos{0};
+  alignas(64) std::atomic<size_t> dequeue_pos{0};
+};
+
+}  // namespace SkolemFCInt
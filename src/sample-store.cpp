@@ -0,0 +1,175 @@
+/******************************************
+ SkolemFC
+
+ Copyright (C) 2024, Arijit Shaw, Brendan Juba, and Kuldeep S. Meel.
+
+ All rights reserved.
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+***********************************************/
+
+#include "sample-store.h"
+
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <new>
+#include <system_error>
+#include <utility>
+
+using namespace SkolemFCInt;
+
+SampleLayout::SampleLayout(const std::vector<uint32_t>& _vars, uint32_t nvars)
+    : vars(_vars)
+{
+  col_of_var.assign(nvars, std::numeric_limits<uint32_t>::max());
+  for (uint32_t col = 0; col < vars.size(); col++) col_of_var[vars[col]] = col;
+  words_per_row = ((vars.size() + 255) / 256) * 4;
+  if (words_per_row == 0) words_per_row = 4;
+}
+
+void SampleLayout::pack(const std::vector<int>& solution, uint64_t* row) const
+{
+  memset(row, 0, words_per_row * sizeof(uint64_t));
+  for (int lit : solution)
+  {
+    const uint32_t var = std::abs(lit) - 1;
+    if (var >= col_of_var.size()) continue;
+    const uint32_t col = col_of_var[var];
+    if (col == std::numeric_limits<uint32_t>::max() || lit < 0) continue;
+    row[col / 64] |= 1ULL << (col % 64);
+  }
+}
+
+SampleStore::~SampleStore() { release(); }
+
+void SampleStore::release()
+{
+  if (data == nullptr) return;
+  if (spill_fd >= 0)
+  {
+    munmap(data, bytes());
+    close(spill_fd);
+    spill_fd = -1;
+  }
+  else
+    free(data);
+  data = nullptr;
+  cap_rows = 0;
+}
+
+void SampleStore::init(std::shared_ptr<const SampleLayout> _layout,
+                       const std::string& _spill_dir)
+{
+  release();
+  layout = std::move(_layout);
+  spill_dir = _spill_dir;
+  clear();
+}
+
+void SampleStore::swap(SampleStore& other)
+{
+  std::swap(layout, other.layout);
+  std::swap(spill_dir, other.spill_dir);
+  std::swap(data, other.data);
+  std::swap(rows, other.rows);
+  std::swap(cap_rows, other.cap_rows);
+  std::swap(ids, other.ids);
+  std::swap(spill_fd, other.spill_fd);
+}
+
+void SampleStore::grow(uint64_t min_rows)
+{
+  uint64_t new_cap = std::max<uint64_t>(cap_rows * 2, 512);
+  while (new_cap < min_rows) new_cap *= 2;
+  const size_t row_bytes = layout->words_per_row * sizeof(uint64_t);
+  const size_t new_bytes = new_cap * row_bytes;
+
+  if (!spill_dir.empty() && spill_fd < 0 && data == nullptr)
+  {
+    // Unlinked right away: the file goes when the last mapping does
+    std::string path = spill_dir + "/skolemfc_samples_XXXXXX";
+    spill_fd = mkstemp(&path[0]);
+    if (spill_fd < 0)
+    {
+      perror("mkstemp");
+      std::cout << "c [sklfc] cannot spill samples to " << spill_dir
+                << ", keeping them in memory" << std::endl;
+      spill_dir.clear();
+    }
+    else
+      unlink(path.c_str());
+  }
+
+  if (spill_fd >= 0)
+  {
+    if (data != nullptr) munmap(data, bytes());
+    data = nullptr;
+    if (ftruncate(spill_fd, new_bytes) != 0)
+      throw std::system_error(errno, std::generic_category(), "ftruncate");
+    void* mapped =
+        mmap(NULL, new_bytes, PROT_READ | PROT_WRITE, MAP_SHARED, spill_fd, 0);
+    if (mapped == MAP_FAILED)
+      throw std::system_error(errno, std::generic_category(), "mmap");
+    data = (uint64_t*)mapped;
+  }
+  else
+  {
+    uint64_t* fresh = (uint64_t*)aligned_alloc(64, new_bytes);
+    if (fresh == nullptr) throw std::bad_alloc();
+    if (data != nullptr)
+    {
+      memcpy(fresh, data, rows * row_bytes);
+      free(data);
+    }
+    data = fresh;
+  }
+  cap_rows = new_cap;
+}
+
+uint64_t* SampleStore::new_row()
+{
+  if (rows == cap_rows) grow(rows + 1);
+  return data + (rows++) * layout->words_per_row;
+}
+
+void SampleStore::append(const std::vector<int>& solution, uint64_t index)
+{
+  layout->pack(solution, new_row());
+  ids.push_back(index);
+}
+
+void SampleStore::append(const uint64_t* row, uint64_t index)
+{
+  memcpy(new_row(), row, layout->words_per_row * sizeof(uint64_t));
+  ids.push_back(index);
+}
+
+void SampleStore::append_all(const SampleStore& other)
+{
+  if (rows + other.rows > cap_rows) grow(rows + other.rows);
+  for (uint64_t i = 0; i < other.rows; i++)
+    append(other.data + i * layout->words_per_row, other.ids[i]);
+}
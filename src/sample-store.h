@@ -0,0 +1,124 @@
+/******************************************
+ SkolemFC
+
+ Copyright (C) 2024, Arijit Shaw, Brendan Juba, and Kuldeep S. Meel.
+
+ All rights reserved.
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+***********************************************/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#ifdef CMS_LOCAL_BUILD
+#include "cryptominisat.h"
+#else
+#include <cryptominisat5/cryptominisat.h>
+#endif
+
+namespace SkolemFCInt {
+
+using CMSat::Lit;
+
+// Which X variable every bit column of a sample row stands for. Rows are
+// padded to whole 256-bit words so that each row starts on a SIMD boundary.
+struct SampleLayout
+{
+  SampleLayout(const std::vector<uint32_t>& _vars, uint32_t nvars);
+
+  // Packs a sampler solution (DIMACS literals over vars, in any order)
+  void pack(const std::vector<int>& solution, uint64_t* row) const;
+
+  std::vector<uint32_t> vars;
+  std::vector<uint32_t> col_of_var;  // indexed by variable
+  uint32_t words_per_row;
+};
+
+// One packed sample, read in place
+struct SampleRef
+{
+  const uint64_t* bits;
+  const SampleLayout* layout;
+
+  uint32_t size() const { return layout->vars.size(); }
+  Lit lit(uint32_t col) const
+  {
+    const bool set = (bits[col / 64] >> (col % 64)) & 1;
+    return Lit(layout->vars[col], !set);
+  }
+};
+
+// Samples of X one bit per variable, one row per sample, each with its
+// index in the global sample sequence. With a spill directory the rows live
+// in an unlinked file mapped into memory, so the kernel can write them back
+// to disk instead of keeping them resident.
+class SampleStore
+{
+ public:
+  SampleStore() = default;
+  ~SampleStore();
+  SampleStore(const SampleStore&) = delete;
+  SampleStore& operator=(const SampleStore&) = delete;
+
+  void init(std::shared_ptr<const SampleLayout> _layout,
+            const std::string& _spill_dir = "");
+  void swap(SampleStore& other);
+
+  uint64_t size() const { return rows; }
+  bool empty() const { return rows == 0; }
+  void clear()
+  {
+    rows = 0;
+    ids.clear();
+  }
+
+  void append(const std::vector<int>& solution, uint64_t index);
+  void append(const uint64_t* row, uint64_t index);
+  void append_all(const SampleStore& other);
+
+  SampleRef row(uint64_t i) const
+  {
+    return SampleRef{data + i * layout->words_per_row, layout.get()};
+  }
+  uint64_t index(uint64_t i) const { return ids[i]; }
+  const SampleLayout& get_layout() const { return *layout; }
+  size_t bytes() const { return cap_rows * layout->words_per_row * 8; }
+  bool spilled() const { return spill_fd >= 0; }
+
+ private:
+  uint64_t* new_row();
+  void grow(uint64_t min_rows);
+  void release();
+
+  std::shared_ptr<const SampleLayout> layout;
+  std::string spill_dir;
+  uint64_t* data = nullptr;
+  uint64_t rows = 0;
+  uint64_t cap_rows = 0;
+  std::vector<uint64_t> ids;
+  int spill_fd = -1;
+};
+
+}  // namespace SkolemFCInt
@@ -0,0 +1,147 @@
+/******************************************
+ SkolemFC
+
+ Copyright (C) 2024, Arijit Shaw, Brendan Juba, and Kuldeep S. Meel.
+
+ All rights reserved.
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+***********************************************/
+
+#include "serve.h"
+
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <iostream>
+
+using namespace SkolemFC;
+
+// Copies the request into an anonymous in-memory file, so the parser can
+// open it by path like any input
+static int receive_formula(int client)
+{
+  int fd = memfd_create("skolemfc_job", MFD_CLOEXEC);
+  if (fd < 0) return -1;
+  char buffer[1 << 16];
+  for (;;)
+  {
+    ssize_t n = read(client, buffer, sizeof(buffer));
+    if (n < 0 && errno == EINTR) continue;
+    if (n < 0)
+    {
+      close(fd);
+      return -1;
+    }
+    if (n == 0) break;
+    for (ssize_t done = 0; done < n;)
+    {
+      ssize_t w = write(fd, buffer + done, n - done);
+      if (w < 0)
+      {
+        close(fd);
+        return -1;
+      }
+      done += w;
+    }
+  }
+  lseek(fd, 0, SEEK_SET);
+  return fd;
+}
+
+int SkolemFC::run_server(const std::string& socket_path,
+                          const ServeJob& run_one)
+{
+  // A client that goes away mid-job must not take the server with it
+  signal(SIGPIPE, SIG_IGN);
+
+  struct sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (socket_path.size() >= sizeof(addr.sun_path))
+  {
+    std::cerr << "ERROR: socket path too long: " << socket_path << std::endl;
+    return 1;
+  }
+  strcpy(addr.sun_path, socket_path.c_str());
+
+  int server = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (server < 0)
+  {
+    perror("socket");
+    return 1;
+  }
+  unlink(socket_path.c_str());
+  if (bind(server, (struct sockaddr*)&addr, sizeof(addr)) < 0
+      || listen(server, 16) < 0)
+  {
+    perror("bind");
+    close(server);
+    return 1;
+  }
+  std::cout << "c [sklfc] serving on " << socket_path << std::endl;
+
+  for (;;)
+  {
+    int client = accept4(server, NULL, NULL, SOCK_CLOEXEC);
+    if (client < 0)
+    {
+      if (errno == EINTR) continue;
+      perror("accept");
+      break;
+    }
+
+    int formula = receive_formula(client);
+    if (formula < 0)
+    {
+      const char* msg = "e could not receive the formula\n";
+      (void)!write(client, msg, strlen(msg));
+      close(client);
+      continue;
+    }
+
+    // The job writes to stdout through both cout and printf; point the
+    // descriptor itself at the client for its duration
+    std::cout.flush();
+    fflush(stdout);
+    int saved_stdout = dup(STDOUT_FILENO);
+    dup2(client, STDOUT_FILENO);
+
+    run_one("/proc/self/fd/" + std::to_string(formula));
+
+    std::cout.flush();
+    fflush(stdout);
+    std::cout.clear();
+    clearerr(stdout);
+    dup2(saved_stdout, STDOUT_FILENO);
+    close(saved_stdout);
+    close(formula);
+    close(client);
+  }
+
+  close(server);
+  unlink(socket_path.c_str());
+  return 1;
+}
@@ -0,0 +1,45 @@
+/******************************************
+ SkolemFC
+
+ Copyright (C) 2024, Arijit Shaw, Brendan Juba, and Kuldeep S. Meel.
+
+ All rights reserved.
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+***********************************************/
+
+#pragma once
+
+#include <functional>
+#include <string>
+
+namespace SkolemFC {
+
+// Handles one job: the formula is in the file at formula_path, and
+// everything the job prints to stdout reaches the client
+typedef std::function<void(const std::string& formula_path)> ServeJob;
+
+// Listens on a Unix domain socket. A client sends a QDIMACS formula and
+// shuts down its sending side; the job's log streams back over the same
+// connection while it runs, ending with its "s fc" line (or an "e" line),
+// and then the server closes it. Jobs are run one after the other, each
+// with the whole machine. Returns only on error.
+int run_server(const std::string& socket_path, const ServeJob& run_one);
+
+}  // namespace SkolemFC
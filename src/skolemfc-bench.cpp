@@ -0,0 +1,486 @@
+/******************************************
+ SkolemFC
+
+ Copyright (C) 2024, Arijit Shaw, Brendan Juba, and Kuldeep S. Meel.
+
+ All rights reserved.
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+***********************************************/
+
+// Runs the instances of a benchmark suite through the skolemfc binary under
+// every thread count and oracle mode the suite lists, and records for each
+// run its wall and CPU time, peak RSS, iterations and the error of the
+// estimate against the known exact count. The results go to a JSON file and
+// are compared with a stored baseline of the same format.
+
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <boost/program_options.hpp>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace po = boost::program_options;
+using std::cerr;
+using std::cout;
+using std::endl;
+using std::string;
+using std::vector;
+
+namespace {
+
+struct Instance
+{
+  string name;
+  string path;
+  double exact = 0;  // log2 of the number of Skolem functions
+};
+
+struct Mode
+{
+  string name;
+  vector<string> args;
+};
+
+struct Suite
+{
+  vector<Instance> instances;
+  vector<uint32_t> threads;
+  vector<Mode> modes;
+};
+
+struct Run
+{
+  string instance, mode;
+  uint32_t threads = 1;
+  string status = "error";  // ok, no-result or error
+  double wall_seconds = 0, cpu_seconds = 0;
+  double peak_rss_mb = 0;
+  uint64_t iterations = 0;
+  double estimate = 0, exact = 0, rel_error = 0;
+
+  string key() const
+  {
+    return instance + "/" + mode + "/j" + std::to_string(threads);
+  }
+};
+
+string dir_of(const string& path)
+{
+  const size_t slash = path.rfind('/');
+  return slash == string::npos ? "." : path.substr(0, slash);
+}
+
+// instance <name> <path> <exact log2 count>, threads <j>..., mode <name>
+// [options...]; paths are relative to the suite file
+bool read_suite(const string& file, Suite& suite)
+{
+  std::ifstream in(file);
+  if (!in) return false;
+  string line;
+  uint32_t line_num = 0;
+  while (getline(in, line))
+  {
+    line_num++;
+    std::istringstream words(line);
+    string kind;
+    if (!(words >> kind) || kind[0] == '#') continue;
+    if (kind == "instance")
+    {
+      Instance inst;
+      if (!(words >> inst.name >> inst.path >> inst.exact))
+      {
+        cerr << "ERROR: " << file << ":" << line_num
+             << ": expected 'instance <name> <path> <exact log2 count>'"
+             << endl;
+        return false;
+      }
+      if (inst.path[0] != '/') inst.path = dir_of(file) + "/" + inst.path;
+      suite.instances.push_back(inst);
+    }
+    else if (kind == "threads")
+    {
+      uint32_t j;
+      while (words >> j) suite.threads.push_back(j);
+    }
+    else if (kind == "mode")
+    {
+      Mode mode;
+      words >> mode.name;
+      string arg;
+      while (words >> arg) mode.args.push_back(arg);
+      suite.modes.push_back(mode);
+    }
+    else
+    {
+      cerr << "ERROR: " << file << ":" << line_num << ": unknown entry '"
+           << kind << "'" << endl;
+      return false;
+    }
+  }
+  if (suite.threads.empty()) suite.threads.push_back(1);
+  if (suite.modes.empty()) suite.modes.push_back(Mode{"default", {}});
+  return true;
+}
+
+// Last number on the first line starting with prefix
+bool find_value(const string& output, const string& prefix, double& found)
+{
+  std::istringstream lines(output);
+  string line;
+  while (getline(lines, line))
+  {
+    if (line.rfind(prefix, 0) != 0) continue;
+    std::istringstream rest(line.substr(prefix.size()));
+    return (bool)(rest >> found);
+  }
+  return false;
+}
+
+Run run_one(const string& binary,
+            const Instance& inst,
+            const Mode& mode,
+            uint32_t threads,
+            const vector<string>& extra)
+{
+  Run run;
+  run.instance = inst.name;
+  run.mode = mode.name;
+  run.threads = threads;
+  run.exact = inst.exact;
+
+  vector<string> args{binary, "-j", std::to_string(threads)};
+  args.insert(args.end(), mode.args.begin(), mode.args.end());
+  args.insert(args.end(), extra.begin(), extra.end());
+  args.push_back(inst.path);
+  vector<char*> argv;
+  for (auto& a : args) argv.push_back(&a[0]);
+  argv.push_back(nullptr);
+
+  int out_pipe[2];
+  if (pipe(out_pipe) != 0) return run;
+  const auto start = std::chrono::steady_clock::now();
+  pid_t pid = fork();
+  if (pid == 0)
+  {
+    dup2(out_pipe[1], STDOUT_FILENO);
+    close(out_pipe[0]);
+    close(out_pipe[1]);
+    execv(argv[0], argv.data());
+    perror("execv");
+    _exit(127);
+  }
+  close(out_pipe[1]);
+  if (pid < 0)
+  {
+    close(out_pipe[0]);
+    return run;
+  }
+
+  string output;
+  char buffer[4096];
+  ssize_t n;
+  while ((n = read(out_pipe[0], buffer, sizeof(buffer))) != 0)
+  {
+    if (n < 0 && errno == EINTR) continue;
+    if (n < 0) break;
+    output.append(buffer, n);
+  }
+  close(out_pipe[0]);
+
+  // wait4 gives the child's own CPU time and peak RSS, threads included
+  int status = 0;
+  struct rusage usage;
+  while (wait4(pid, &status, 0, &usage) < 0 && errno == EINTR)
+  {
+  }
+  run.wall_seconds = std::chrono::duration<double>(
+                         std::chrono::steady_clock::now() - start)
+                         .count();
+  run.cpu_seconds = usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6
+                    + usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+  run.peak_rss_mb = usage.ru_maxrss / 1024.0;
+
+  double its = 0;
+  if (find_value(output, "c [sklfc] iterations:", its))
+    run.iterations = (uint64_t)its;
+  if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+    run.status = "error";
+  else if (!find_value(output, "s fc 2 ** ", run.estimate))
+    run.status = "no-result";
+  else
+  {
+    run.status = "ok";
+    if (run.exact > 0)
+      run.rel_error = std::fabs(run.estimate - run.exact) / run.exact;
+    else
+      run.rel_error = std::fabs(run.estimate);
+  }
+  return run;
+}
+
+// One run per line, so a baseline can be read back without a JSON parser
+void write_runs(std::ostream& out, const vector<Run>& runs)
+{
+  out << std::fixed << std::setprecision(4);
+  out << "{\"runs\": [\n";
+  for (size_t i = 0; i < runs.size(); i++)
+  {
+    const Run& r = runs[i];
+    out << "  {\"instance\": \"" << r.instance << "\", \"mode\": \""
+        << r.mode << "\", \"threads\": " << r.threads << ", \"status\": \""
+        << r.status << "\", \"wall_seconds\": " << r.wall_seconds
+        << ", \"cpu_seconds\": " << r.cpu_seconds
+        << ", \"peak_rss_mb\": " << r.peak_rss_mb
+        << ", \"iterations\": " << r.iterations
+        << ", \"estimate\": " << r.estimate << ", \"exact\": " << r.exact
+        << ", \"rel_error\": " << r.rel_error << "}"
+        << (i + 1 < runs.size() ? ",\n" : "\n");
+  }
+  out << "]}\n";
+}
+
+string string_field(const string& line, const string& name)
+{
+  const string key = "\"" + name + "\": \"";
+  const size_t at = line.find(key);
+  if (at == string::npos) return "";
+  const size_t begin = at + key.size();
+  return line.substr(begin, line.find('"', begin) - begin);
+}
+
+double number_field(const string& line, const string& name)
+{
+  const string key = "\"" + name + "\": ";
+  const size_t at = line.find(key);
+  if (at == string::npos) return 0;
+  return strtod(line.c_str() + at + key.size(), nullptr);
+}
+
+bool read_runs(const string& file, std::map<string, Run>& runs)
+{
+  std::ifstream in(file);
+  if (!in) return false;
+  string line;
+  while (getline(in, line))
+  {
+    if (line.find("\"instance\"") == string::npos) continue;
+    Run r;
+    r.instance = string_field(line, "instance");
+    r.mode = string_field(line, "mode");
+    r.status = string_field(line, "status");
+    r.threads = (uint32_t)number_field(line, "threads");
+    r.wall_seconds = number_field(line, "wall_seconds");
+    r.cpu_seconds = number_field(line, "cpu_seconds");
+    r.peak_rss_mb = number_field(line, "peak_rss_mb");
+    r.iterations = (uint64_t)number_field(line, "iterations");
+    r.estimate = number_field(line, "estimate");
+    r.exact = number_field(line, "exact");
+    r.rel_error = number_field(line, "rel_error");
+    runs[r.key()] = r;
+  }
+  return true;
+}
+
+struct Limits
+{
+  double tolerance;     // allowed slowdown or growth, as a fraction
+  double min_seconds;   // differences below this are noise
+  double max_error;     // allowed relative error of an estimate
+};
+
+// Prints every regression of run against base and returns how many
+uint32_t compare(const Run& run, const Run* base, const Limits& lim)
+{
+  uint32_t found = 0;
+  auto report = [&](const string& what) {
+    cout << "REGRESSION " << run.key() << ": " << what << endl;
+    found++;
+  };
+  if (run.status != "ok")
+    report("status " + run.status);
+  else if (run.rel_error > lim.max_error)
+    report("estimate " + std::to_string(run.estimate) + " is off the exact "
+           + std::to_string(run.exact) + " by more than "
+           + std::to_string(lim.max_error));
+  if (base == nullptr || base->status != "ok") return found;
+
+  auto grew = [&](double now, double before, double floor) {
+    return now > before * (1 + lim.tolerance) && now - before > floor;
+  };
+  if (grew(run.wall_seconds, base->wall_seconds, lim.min_seconds))
+    report("wall time " + std::to_string(base->wall_seconds) + " -> "
+           + std::to_string(run.wall_seconds) + " s");
+  if (grew(run.cpu_seconds, base->cpu_seconds, lim.min_seconds))
+    report("CPU time " + std::to_string(base->cpu_seconds) + " -> "
+           + std::to_string(run.cpu_seconds) + " s");
+  if (grew(run.peak_rss_mb, base->peak_rss_mb, 16))
+    report("peak RSS " + std::to_string(base->peak_rss_mb) + " -> "
+           + std::to_string(run.peak_rss_mb) + " MB");
+  return found;
+}
+
+}  // namespace
+
+int main(int argc, char** argv)
+{
+  string binary = "./skolemfc";
+  string suite_file = "bench/suite.txt";
+  string out_file = "bench-results.json";
+  string baseline_file;
+  bool update_baseline = false;
+  uint32_t repeat = 1;
+  Limits lim{0.2, 0.5, 0.8};
+  vector<string> extra;
+
+  po::options_description opts("skolemfc-bench options");
+  opts.add_options()("help,h", "Prints help")(
+      "skolemfc",
+      po::value(&binary)->default_value(binary),
+      "SkolemFC binary to benchmark")(
+      "suite",
+      po::value(&suite_file)->default_value(suite_file),
+      "Suite file listing instances, thread counts and oracle modes")(
+      "out",
+      po::value(&out_file)->default_value(out_file),
+      "JSON file for the results")(
+      "baseline",
+      po::value(&baseline_file),
+      "Results of an earlier run to compare against")(
+      "update-baseline",
+      po::bool_switch(&update_baseline),
+      "Write the results to --baseline instead of comparing")(
+      "repeat",
+      po::value(&repeat)->default_value(repeat),
+      "Runs of every configuration; the fastest one is kept")(
+      "tolerance",
+      po::value(&lim.tolerance)->default_value(lim.tolerance),
+      "Slowdown or memory growth over the baseline, as a fraction, that "
+      "counts as a regression")(
+      "min-seconds",
+      po::value(&lim.min_seconds)->default_value(lim.min_seconds),
+      "Time differences below this many seconds are never regressions")(
+      "max-error",
+      po::value(&lim.max_error)->default_value(lim.max_error),
+      "Largest relative error of an estimate against the exact count")(
+      "skolemfc-arg",
+      po::value(&extra),
+      "Extra option passed to every run, may be repeated");
+
+  po::variables_map vm;
+  try
+  {
+    po::store(po::parse_command_line(argc, argv, opts), vm);
+    po::notify(vm);
+  }
+  catch (const po::error& e)
+  {
+    cerr << "ERROR: " << e.what() << endl;
+    return 1;
+  }
+  if (vm.count("help"))
+  {
+    cout << opts << endl;
+    return 0;
+  }
+  if (update_baseline && baseline_file.empty())
+  {
+    cerr << "ERROR: --update-baseline needs --baseline <file>" << endl;
+    return 1;
+  }
+
+  Suite suite;
+  if (!read_suite(suite_file, suite))
+  {
+    cerr << "ERROR: could not read suite '" << suite_file << "'" << endl;
+    return 1;
+  }
+
+  vector<Run> runs;
+  for (const Instance& inst : suite.instances)
+  {
+    for (const Mode& mode : suite.modes)
+    {
+      for (uint32_t threads : suite.threads)
+      {
+        Run best;
+        for (uint32_t i = 0; i < std::max<uint32_t>(1, repeat); i++)
+        {
+          Run r = run_one(binary, inst, mode, threads, extra);
+          // Any ok run beats a failed one, however fast that failed
+          const bool r_ok = r.status == "ok", best_ok = best.status == "ok";
+          if (i == 0 || (r_ok && !best_ok)
+              || (r_ok == best_ok && r.wall_seconds < best.wall_seconds))
+            best = r;
+        }
+        cout << "c " << std::left << std::setw(40) << best.key() << std::right
+             << std::fixed << std::setprecision(2) << " " << std::setw(9)
+             << best.status << " wall " << std::setw(8) << best.wall_seconds
+             << " s  cpu " << std::setw(8) << best.cpu_seconds << " s  rss "
+             << std::setw(8) << best.peak_rss_mb << " MB  err "
+             << std::setprecision(4) << best.rel_error << endl;
+        runs.push_back(best);
+      }
+    }
+  }
+
+  std::ofstream out(out_file);
+  write_runs(out, runs);
+  if (!out)
+  {
+    cerr << "ERROR: could not write '" << out_file << "'" << endl;
+    return 1;
+  }
+
+  if (update_baseline)
+  {
+    std::ofstream base_out(baseline_file);
+    write_runs(base_out, runs);
+    cout << "c baseline written to " << baseline_file << endl;
+    return 0;
+  }
+
+  std::map<string, Run> baseline;
+  if (!baseline_file.empty() && !read_runs(baseline_file, baseline))
+  {
+    cout << "c no baseline in " << baseline_file
+         << ", record one with --update-baseline" << endl;
+  }
+  uint32_t regressions = 0;
+  for (const Run& r : runs)
+  {
+    auto it = baseline.find(r.key());
+    const Run* base = it == baseline.end() ? nullptr : &it->second;
+    regressions += compare(r, base, lim);
+  }
+  cout << "c " << runs.size() << " runs, " << regressions << " regression(s)"
+       << endl;
+  return regressions == 0 ? 0 : 1;
+}
@@ -0,0 +1,483 @@
+/******************************************
+ SkolemFC
+
+ Copyright (C) 2024, Arijit Shaw, Brendan Juba, and Kuldeep S. Meel.
+
+ All rights reserved.
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+***********************************************/
+
+// Writes synthetic QDIMACS instances (forall X, exists Y) for scaling
+// studies: n-bit factorization, parity AIGs of given depth, bit-vector
+// inverse problems and random k-CNF. Every family is generated twice, once
+// to count variables and clauses for the header and once to write, so a
+// formula of any size streams to disk through one fixed buffer.
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <boost/program_options.hpp>
+#include <cerrno>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "seed-stream.h"
+
+namespace po = boost::program_options;
+using SkolemFCInt::splitmix64;
+using std::cerr;
+using std::endl;
+using std::string;
+using std::vector;
+
+namespace {
+
+// Clauses over DIMACS literals. In the counting pass nothing is written.
+class Cnf
+{
+ public:
+  Cnf(int _fd, bool _emit) : fd(_fd), emit(_emit)
+  {
+    if (emit) buffer.resize(buffer_size);
+  }
+  ~Cnf() { flush(); }
+
+  int new_var() { return ++nvars; }
+  vector<int> new_vars(uint32_t n)
+  {
+    vector<int> vars(n);
+    for (auto& v : vars) v = new_var();
+    return vars;
+  }
+
+  void clause(std::initializer_list<int> lits)
+  {
+    clause(lits.begin(), lits.end());
+  }
+  template <class It>
+  void clause(It begin, It end)
+  {
+    nclauses++;
+    if (!emit) return;
+    for (It l = begin; l != end; ++l) put_int(*l, ' ');
+    put_int(0, '\n');
+  }
+
+  // Gates, each output a fresh variable defined by its inputs
+  int and2(int a, int b)
+  {
+    const int g = new_var();
+    clause({-g, a});
+    clause({-g, b});
+    clause({g, -a, -b});
+    return g;
+  }
+  int or2(int a, int b) { return -and2(-a, -b); }
+  int xor2(int a, int b)
+  {
+    // As an AIG: not (not (a and not b) and not (not a and b))
+    return -and2(-and2(a, -b), -and2(-a, b));
+  }
+  void equal(int a, int b)
+  {
+    clause({-a, b});
+    clause({a, -b});
+  }
+  // Sum and carry of a + b + c
+  std::pair<int, int> full_adder(int a, int b, int c)
+  {
+    const int ab = xor2(a, b);
+    return {xor2(ab, c), or2(and2(a, b), and2(ab, c))};
+  }
+
+  void put(const char* s, size_t n)
+  {
+    if (!emit) return;
+    if (used + n > buffer.size()) flush();
+    if (n > buffer.size())
+    {
+      write_all(s, n);
+      return;
+    }
+    memcpy(&buffer[used], s, n);
+    used += n;
+  }
+  void put(const string& s) { put(s.data(), s.size()); }
+  void put_int(int64_t v, char sep)
+  {
+    if (used + 24 > buffer.size()) flush();
+    char* out = &buffer[used];
+    char digits[24];
+    int n = 0;
+    uint64_t u = v < 0 ? -(uint64_t)v : (uint64_t)v;
+    do
+    {
+      digits[n++] = '0' + u % 10;
+      u /= 10;
+    } while (u != 0);
+    if (v < 0) *out++ = '-';
+    while (n > 0) *out++ = digits[--n];
+    *out++ = sep;
+    used = out - buffer.data();
+  }
+  void flush()
+  {
+    if (!emit || used == 0) return;
+    write_all(buffer.data(), used);
+    used = 0;
+  }
+
+  int nvars = 0;
+  uint64_t nclauses = 0;
+  bool failed = false;
+
+ private:
+  void write_all(const char* s, size_t n)
+  {
+    while (n > 0 && !failed)
+    {
+      ssize_t w = write(fd, s, n);
+      if (w < 0 && errno == EINTR) continue;
+      if (w < 0)
+      {
+        failed = true;
+        return;
+      }
+      s += w;
+      n -= w;
+    }
+  }
+
+  static const size_t buffer_size = 1 << 22;
+  int fd;
+  bool emit;
+  vector<char> buffer;
+  size_t used = 0;
+};
+
+struct Options
+{
+  string family;
+  uint32_t bits = 10;
+  uint32_t depth = 2;
+  uint32_t outputs = 2;
+  string op = "and";
+  uint32_t nx = 10, ny = 30;
+  uint64_t clauses = 120;
+  uint32_t k = 3;
+  uint32_t y_per_clause = 1;
+  uint64_t seed = 1;
+};
+
+// X first, so a formula's X block is 1..|X| whatever the family
+struct Generated
+{
+  vector<int> xs;
+  string exact;  // log2 of the Skolem function count, when known
+};
+
+// a * b = X for the |X|-bit product X, with a and b of half the width
+Generated factorization(Cnf& f, const Options& o)
+{
+  Generated g;
+  g.xs = f.new_vars(o.bits);
+  const uint32_t na = (o.bits + 1) / 2, nb = o.bits - na;
+  const vector<int> a = f.new_vars(na), b = f.new_vars(nb);
+
+  // Array multiplier: add the shifted partial products row by row
+  const int zero = f.new_var();
+  f.clause({-zero});
+  vector<int> acc(o.bits, zero);
+  for (uint32_t j = 0; j < nb; j++)
+  {
+    int carry = zero;
+    for (uint32_t i = 0; i + j < o.bits; i++)
+    {
+      const int pp = i < na ? f.and2(a[i], b[j]) : zero;
+      auto sc = f.full_adder(acc[i + j], pp, carry);
+      acc[i + j] = sc.first;
+      carry = sc.second;
+    }
+    // The product of na- and nb-bit numbers fits in |X| bits
+  }
+  for (uint32_t i = 0; i < o.bits; i++) f.equal(acc[i], g.xs[i]);
+  return g;
+}
+
+// A balanced XOR tree of the given depth, as an AIG, over 2^depth inputs X;
+// the outputs must XOR to its root. Every X has 2^(outputs-1) extensions.
+Generated parity(Cnf& f, const Options& o)
+{
+  Generated g;
+  g.xs = f.new_vars(1u << o.depth);
+  vector<int> level = g.xs;
+  while (level.size() > 1)
+  {
+    vector<int> next;
+    for (size_t i = 0; i + 1 < level.size(); i += 2)
+      next.push_back(f.xor2(level[i], level[i + 1]));
+    level = next;
+  }
+  const vector<int> outs = f.new_vars(std::max(1u, o.outputs));
+  int acc = outs[0];
+  for (size_t i = 1; i < outs.size(); i++) acc = f.xor2(acc, outs[i]);
+  f.equal(acc, level[0]);
+
+  // 2^(2^depth) overflows a double from depth 10 on; leave the count out
+  // then rather than print inf
+  const double exact = std::ldexp(1.0, g.xs.size()) * (outs.size() - 1);
+  if (std::isfinite(exact)) g.exact = std::to_string(exact);
+  return g;
+}
+
+// Find x with op(x, s) = t for the X inputs s and t; ule asks for
+// (x & s) <=u t instead
+Generated bv_inverse(Cnf& f, const Options& o)
+{
+  Generated g;
+  const vector<int> s = f.new_vars(o.bits), t = f.new_vars(o.bits);
+  g.xs = s;
+  g.xs.insert(g.xs.end(), t.begin(), t.end());
+  const vector<int> x = f.new_vars(o.bits);
+  const double w = o.bits;
+
+  vector<int> r(o.bits);
+  if (o.op == "add")
+  {
+    int carry = f.new_var();
+    f.clause({-carry});
+    for (uint32_t i = 0; i < o.bits; i++)
+    {
+      auto sc = f.full_adder(x[i], s[i], carry);
+      r[i] = sc.first;
+      carry = sc.second;
+    }
+    g.exact = "0";
+  }
+  else if (o.op == "and" || o.op == "or" || o.op == "xor")
+  {
+    for (uint32_t i = 0; i < o.bits; i++)
+      r[i] = o.op == "and"  ? f.and2(x[i], s[i])
+             : o.op == "or" ? f.or2(x[i], s[i])
+                            : f.xor2(x[i], s[i]);
+    // A free x bit per (s, t) bit pair that allows both values, of the
+    // three pairs that allow any
+    g.exact = o.op == "xor" ? "0" : std::to_string(w * std::pow(3.0, w - 1));
+  }
+  else if (o.op == "ule")
+  {
+    // (x & s) <=u t, decided from the most significant bit down
+    int less = f.new_var(), equal = f.new_var();
+    f.clause({-less});
+    f.clause({equal});
+    for (uint32_t i = o.bits; i-- > 0;)
+    {
+      const int xs_bit = f.and2(x[i], s[i]);
+      const int lt_here = f.and2(-xs_bit, t[i]);
+      const int eq_here = -f.xor2(xs_bit, t[i]);
+      less = f.or2(less, f.and2(equal, lt_here));
+      equal = f.and2(equal, eq_here);
+    }
+    f.clause({less, equal});
+    return g;
+  }
+  else
+  {
+    cerr << "ERROR: unknown --op '" << o.op
+         << "', expected add, and, or, xor or ule" << endl;
+    exit(1);
+  }
+  for (uint32_t i = 0; i < o.bits; i++) f.equal(r[i], t[i]);
+  return g;
+}
+
+// Random k-CNF over |X| + |Y| variables; every clause has at least
+// y_per_clause Y literals
+Generated random_kcnf(Cnf& f, const Options& o)
+{
+  Generated g;
+  g.xs = f.new_vars(o.nx);
+  const vector<int> ys = f.new_vars(o.ny);
+  const uint32_t nvars = o.nx + o.ny;
+  uint64_t state = splitmix64(o.seed);
+  auto next = [&](uint64_t bound) {
+    state = splitmix64(state);
+    return state % bound;
+  };
+  vector<int> lits(o.k);
+  for (uint64_t c = 0; c < o.clauses; c++)
+  {
+    for (uint32_t i = 0; i < o.k; i++)
+    {
+      const int var =
+          i < o.y_per_clause ? ys[next(ys.size())] : (int)next(nvars) + 1;
+      lits[i] = next(2) ? var : -var;
+    }
+    f.clause(lits.begin(), lits.end());
+  }
+  return g;
+}
+
+Generated generate(Cnf& f, const Options& o)
+{
+  if (o.family == "factorization") return factorization(f, o);
+  if (o.family == "parity") return parity(f, o);
+  if (o.family == "bvinv") return bv_inverse(f, o);
+  return random_kcnf(f, o);
+}
+
+}  // namespace
+
+int main(int argc, char** argv)
+{
+  Options o;
+  string out_file;
+  po::options_description opts(
+      "Usage: skolemfc-gen FAMILY [options]\n"
+      "FAMILY is factorization, parity, bvinv or random\n\n"
+      "skolemfc-gen options");
+  opts.add_options()("help,h", "Prints help")(
+      "out,o",
+      po::value(&out_file),
+      "Output file, stdout by default")(
+      "bits,n",
+      po::value(&o.bits)->default_value(o.bits),
+      "factorization: bits of the product X; bvinv: bit-vector width")(
+      "depth",
+      po::value(&o.depth)->default_value(o.depth),
+      "parity: depth of the XOR tree over 2^depth X inputs")(
+      "outputs",
+      po::value(&o.outputs)->default_value(o.outputs),
+      "parity: Y outputs whose XOR must equal the parity of X")(
+      "op",
+      po::value(&o.op)->default_value(o.op),
+      "bvinv: add, and, or, xor (find x with x op s = t) or ule "
+      "((x & s) <=u t)")(
+      "x",
+      po::value(&o.nx)->default_value(o.nx),
+      "random: number of X variables")(
+      "y",
+      po::value(&o.ny)->default_value(o.ny),
+      "random: number of Y variables")(
+      "clauses,m",
+      po::value(&o.clauses)->default_value(o.clauses),
+      "random: number of clauses")(
+      "k",
+      po::value(&o.k)->default_value(o.k),
+      "random: literals per clause")(
+      "y-per-clause",
+      po::value(&o.y_per_clause)->default_value(o.y_per_clause),
+      "random: Y literals every clause has at least")(
+      "seed,s",
+      po::value(&o.seed)->default_value(o.seed),
+      "random: seed");
+  po::options_description hidden;
+  hidden.add_options()("family", po::value(&o.family));
+  po::positional_options_description pos;
+  pos.add("family", 1);
+  po::options_description all;
+  all.add(opts).add(hidden);
+
+  po::variables_map vm;
+  try
+  {
+    po::store(po::command_line_parser(argc, argv)
+                  .options(all)
+                  .positional(pos)
+                  .run(),
+              vm);
+    po::notify(vm);
+  }
+  catch (const po::error& e)
+  {
+    cerr << "ERROR: " << e.what() << endl;
+    return 1;
+  }
+  if (vm.count("help") || o.family.empty())
+  {
+    cerr << opts << endl;
+    return vm.count("help") ? 0 : 1;
+  }
+  if (o.family != "factorization" && o.family != "parity"
+      && o.family != "bvinv" && o.family != "random")
+  {
+    cerr << "ERROR: unknown family '" << o.family << "'" << endl;
+    return 1;
+  }
+  if (o.family == "random"
+      && (o.k == 0 || o.ny == 0 || o.y_per_clause > o.k))
+  {
+    cerr << "ERROR: random needs --y > 0 and --y-per-clause <= --k" << endl;
+    return 1;
+  }
+  if (o.family == "parity" && o.depth > 24)
+  {
+    cerr << "ERROR: --depth is at most 24" << endl;
+    return 1;
+  }
+
+  // First pass for the header
+  Cnf counter(-1, false);
+  const Generated shape = generate(counter, o);
+
+  int fd = STDOUT_FILENO;
+  if (!out_file.empty())
+  {
+    fd = open(out_file.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+    {
+      cerr << "ERROR: cannot open '" << out_file << "': " << strerror(errno)
+           << endl;
+      return 1;
+    }
+  }
+
+  bool failed;
+  {
+    Cnf f(fd, true);
+    f.put("c " + o.family + " generated by skolemfc-gen\n");
+    if (!shape.exact.empty())
+      f.put("c exact log2 Skolem function count " + shape.exact + "\n");
+    f.put("p cnf " + std::to_string(counter.nvars) + " "
+          + std::to_string(counter.nclauses) + "\na ");
+    for (int x : shape.xs) f.put_int(x, ' ');
+    f.put("0\ne ");
+    vector<bool> is_x(counter.nvars + 1, false);
+    for (int x : shape.xs) is_x[x] = true;
+    for (int v = 1; v <= counter.nvars; v++)
+      if (!is_x[v]) f.put_int(v, ' ');
+    f.put("0\n");
+    generate(f, o);
+    f.flush();
+    failed = f.failed;
+  }
+  if (fd != STDOUT_FILENO && close(fd) != 0) failed = true;
+  if (failed)
+  {
+    cerr << "ERROR: writing the formula failed: " << strerror(errno) << endl;
+    return 1;
+  }
+  return 0;
+}
@@ -35,6 +35,8 @@
 #include <random>
 
 #include "GitSHA1.h"
+#include "profile.h"
+#include "seed-stream.h"
 #include "time_mem.h"
 
 using std::cout;
@@ -77,64 +79,92 @@ bool SkolemFCInt::SklFCInt::add_exists_var(uint32_t e_var)
   return true;
 }
 
-void SkolemFCInt::SklFCInt::print_formula(const vector<vector<Lit>>& formula)
+void SkolemFCInt::SklFCInt::print_formula(const FormulaView& formula)
 {
   cout << "c Below is created formula" << endl;
-  for (const auto& clause : formula)
-  {
+  formula.for_each([](ClauseRef clause) {
     cout << "c ";
     for (const Lit& lit : clause)
     {
       cout << lit << " ";
     }
     cout << endl;
-  }
+  });
   cout << "c Finished printing G formula" << endl;
 }
 
 void SkolemFCInt::SklFCInt::create_g_formula()
 {
+  ProfileScope span(Probe::g_formula);
   g_formula_clauses.clear();
-  std::vector<uint32_t> mapped_exists_vars(exists_vars.size());
-  // Create a mapping for exists_vars to new variables
-  for (size_t i = 0; i < exists_vars.size(); ++i)
+
+  // Y' variables follow F (and the context), aux variables follow Y'.
+  // Defined outputs still need their primed copy for F(X, Y') to be F, but
+  // they follow the others, so only exists_vars enter (Y != Y').
+  const uint32_t n_primed = exists_vars.size() + defined_vars.size();
+  const uint32_t first_aux = nFVars() + n_primed;
+  const uint32_t not_primed = std::numeric_limits<uint32_t>::max();
+  vector<uint32_t> prime_of(nFVars(), not_primed);
+  uint32_t next_prime = nFVars();
+  for (uint32_t y : exists_vars) prime_of[y] = next_prime++;
+  for (uint32_t y : defined_vars) prime_of[y] = next_prime++;
+
+  // A clause without Y is its own primed copy and goes in only once
+  uint64_t n_with_y = 0, lits_with_y = 0;
+  for (const auto& clause : clauses)
   {
-    mapped_exists_vars[i] =
-        nVars() + i;  // New variable starting from nVars + 1
+    for (const Lit& lit : clause)
+    {
+      if (prime_of[lit.var()] != not_primed)
+      {
+        n_with_y++;
+        lits_with_y += clause.size();
+        break;
+      }
+    }
   }
+  g_formula_clauses.reserve(
+      context_clauses.size() + clauses.size() + n_with_y
+          + 2 * exists_vars.size() + 1,
+      context_clauses.num_lits() + clauses.num_lits() + lits_with_y
+          + 7 * exists_vars.size());
 
-  // Add F(X, Y') to g_formula_clauses
+  // Other Y-components only restrict X, so they go in once, unprimed
+  for (const auto& clause : context_clauses)
+    g_formula_clauses.push_back(clause);
+
+  // F(X, Y) and F(X, Y')
   for (const auto& clause : clauses)
   {
     g_formula_clauses.push_back(clause);
-    new_clause.clear();
+    bool has_y = false;
     for (const Lit& lit : clause)
     {
-      uint32_t var = lit.var();
-      auto it = std::find(exists_vars.begin(), exists_vars.end(), var);
-      if (it != exists_vars.end())
-      {
-        // Map Y variable to corresponding Y' variable
-        size_t index = std::distance(exists_vars.begin(), it);
-        new_clause.push_back(Lit(mapped_exists_vars[index], lit.sign()));
-      }
-      else
+      if (prime_of[lit.var()] != not_primed)
       {
-        new_clause.push_back(lit);
+        has_y = true;
+        break;
       }
     }
-    g_formula_clauses.push_back(new_clause);
+    if (!has_y) continue;
+
+    for (const Lit& lit : clause)
+    {
+      const uint32_t p = prime_of[lit.var()];
+      g_formula_clauses.push_lit(p == not_primed ? lit : Lit(p, lit.sign()));
+    }
+    g_formula_clauses.end_clause();
   }
 
   // Add (Y ≠ Y') to g_formula_clauses
 
   diff_clause.clear();
+  diff_clause.reserve(exists_vars.size());
   for (size_t i = 0; i < exists_vars.size(); ++i)
   {
     uint32_t y = exists_vars[i];
-    uint32_t y_prime = nVars() + i;
-    uint32_t aux_y = nVars() + exists_vars.size()
-                     + i;  // Auxiliary variable for each pair y, y'
+    uint32_t y_prime = prime_of[y];
+    uint32_t aux_y = first_aux + i;  // Auxiliary variable for each pair y, y'
     if (verbosity > 3)
     {
       cout << "c y: " << y + 1 << ", y': " << y_prime + 1
@@ -152,13 +182,236 @@ void SkolemFCInt::SklFCInt::create_g_formula()
   }
 
   g_formula_clauses.push_back(diff_clause);
-  n_g_vars = nVars() + 2 * exists_vars.size();
+  n_g_vars = first_aux + exists_vars.size();
+  span.add_bytes(g_formula_clauses.num_lits() * sizeof(Lit));
 
   cout << "c [sklfc] G formula created with " << g_formula_clauses.size()
-       << " clauses and " << nGVars() << " variables." << endl;
+       << " clauses (" << clauses.size() - n_with_y
+       << " without Y shared by F and F') and " << nGVars() << " variables."
+       << endl;
   if (verbosity > 3) print_formula(g_formula_clauses);
 }
 
+vector<YComponent> SkolemFCInt::SklFCInt::y_components(
+    vector<uint32_t>& x_only_clauses) const
+{
+  x_only_clauses.clear();
+  vector<char> is_x(nVars(), 0);
+  for (uint32_t x : forall_vars) is_x[x] = 1;
+
+  vector<uint32_t> parent(nVars());
+  for (uint32_t v = 0; v < nVars(); v++) parent[v] = v;
+  auto find = [&](uint32_t v) {
+    while (parent[v] != v) v = parent[v] = parent[parent[v]];
+    return v;
+  };
+
+  vector<char> in_clause(nVars(), 0);
+  for (const auto& clause : clauses)
+  {
+    uint32_t first = std::numeric_limits<uint32_t>::max();
+    for (const Lit& l : clause)
+    {
+      const uint32_t v = l.var();
+      if (is_x[v]) continue;
+      in_clause[v] = 1;
+      if (first == std::numeric_limits<uint32_t>::max())
+        first = find(v);
+      else
+        parent[find(v)] = first;
+    }
+  }
+
+  // Components numbered by their lowest variable, so the split is the same
+  // on every run
+  vector<YComponent> comps;
+  vector<uint32_t> comp_of_root(nVars(), std::numeric_limits<uint32_t>::max());
+  vector<uint32_t> loose;
+  for (uint32_t v = 0; v < nVars(); v++)
+  {
+    if (is_x[v]) continue;
+    if (!in_clause[v])
+    {
+      loose.push_back(v);
+      continue;
+    }
+    uint32_t& at = comp_of_root[find(v)];
+    if (at == std::numeric_limits<uint32_t>::max())
+    {
+      at = comps.size();
+      comps.emplace_back();
+    }
+    comps[at].vars.push_back(v);
+  }
+  if (comps.empty()) return comps;
+
+  for (uint32_t i = 0; i < clauses.size(); i++)
+  {
+    uint32_t at = std::numeric_limits<uint32_t>::max();
+    for (const Lit& l : clauses[i])
+    {
+      if (is_x[l.var()]) continue;
+      at = comp_of_root[find(l.var())];
+      break;
+    }
+    if (at == std::numeric_limits<uint32_t>::max())
+      x_only_clauses.push_back(i);
+    else
+      comps[at].clause_ids.push_back(i);
+  }
+
+  // Variables in no clause at all double every count of whichever
+  // component holds them
+  comps[0].vars.insert(comps[0].vars.end(), loose.begin(), loose.end());
+  std::sort(comps[0].vars.begin(), comps[0].vars.end());
+
+  vector<uint32_t> comp_of_var(nVars(), std::numeric_limits<uint32_t>::max());
+  for (uint32_t i = 0; i < comps.size(); i++)
+    for (uint32_t v : comps[i].vars) comp_of_var[v] = i;
+  for (uint32_t y : exists_vars)
+  {
+    if (y < nVars() && comp_of_var[y] != std::numeric_limits<uint32_t>::max())
+      comps[comp_of_var[y]].exists_vars.push_back(y);
+  }
+
+  // A component without existential variables has no |Y| to scale its
+  // threshold by; leave such formulas in one piece
+  for (const auto& comp : comps)
+  {
+    if (comp.exists_vars.empty()) return vector<YComponent>();
+  }
+  return comps;
+}
+
+uint32_t SkolemFCInt::SklFCInt::eliminate_defined_vars(uint64_t max_confl)
+{
+  double start_time = cpuTime();
+  const uint32_t n = nVars();
+  vector<char> is_x(n, 0);
+  for (uint32_t x : forall_vars) is_x[x] = 1;
+
+  // Padoa's method: y is defined by the set D if F(X, Y) and F(X, Y') agree
+  // on D but not on y is unsat. Variable v lives at v in the first copy, at
+  // n + v in the second, and n + n + v switches on v = v' when assumed.
+  CMSat::SATSolver solver;
+  solver.set_seed(seed);
+  solver.set_max_confl(max_confl);
+  solver.new_vars(3 * (size_t)n);
+  auto primed = [&](Lit l) {
+    return is_x[l.var()] ? l : Lit(n + l.var(), l.sign());
+  };
+  vector<Lit> copy;
+  for (const auto& clause : clauses)
+  {
+    copy.assign(clause.begin(), clause.end());
+    solver.add_clause(copy);
+    copy.clear();
+    for (const Lit& l : clause) copy.push_back(primed(l));
+    solver.add_clause(copy);
+  }
+  for (uint32_t v = 0; v < n; v++)
+  {
+    if (is_x[v]) continue;
+    const Lit eq(2 * n + v, false);
+    solver.add_clause({~eq, Lit(v, true), Lit(n + v, false)});
+    solver.add_clause({~eq, Lit(v, false), Lit(n + v, true)});
+  }
+
+  // Every non-X variable is in D until it is found to be defined by the
+  // rest of D. Later outputs tend to be the Tseitin ones, so they go first.
+  vector<char> in_d(n, 0);
+  for (uint32_t v = 0; v < n; v++) in_d[v] = !is_x[v];
+
+  vector<uint32_t> kept;
+  vector<Lit> assumptions;
+  bool out_of_budget = false;
+  for (auto it = exists_vars.rbegin(); it != exists_vars.rend(); ++it)
+  {
+    const uint32_t y = *it;
+    if (out_of_budget || y >= n)
+    {
+      kept.push_back(y);
+      continue;
+    }
+    assumptions.clear();
+    for (uint32_t v = 0; v < n; v++)
+    {
+      if (in_d[v] && v != y) assumptions.push_back(Lit(2 * n + v, false));
+    }
+    assumptions.push_back(Lit(y, false));
+    assumptions.push_back(Lit(n + y, true));
+
+    const CMSat::lbool ret = solver.solve(&assumptions);
+    if (ret == CMSat::l_False)
+    {
+      in_d[y] = 0;
+      defined_vars.push_back(y);
+    }
+    else
+    {
+      if (ret == CMSat::l_Undef) out_of_budget = true;
+      kept.push_back(y);
+    }
+  }
+  std::reverse(kept.begin(), kept.end());
+  exists_vars = kept;
+
+  cout << "c [sklfc] definability: " << defined_vars.size() << " of "
+       << defined_vars.size() + exists_vars.size()
+       << " Y variables are defined by X and the other Y variables, |Y| "
+          "for the threshold is now "
+       << exists_vars.size() << (out_of_budget ? " (conflict budget hit)" : "")
+       << " T: " << std::setprecision(2) << std::fixed
+       << (cpuTime() - start_time) << endl;
+  return defined_vars.size();
+}
+
+static uint64_t mix_vars(uint64_t h,
+                         const vector<uint32_t>& vars,
+                         uint64_t tag)
+{
+  h = splitmix64(h ^ tag ^ vars.size());
+  for (uint32_t v : vars) h = splitmix64(h ^ v);
+  return h;
+}
+
+static uint64_t mix_clauses(uint64_t h, const ClauseArena& arena, uint64_t tag)
+{
+  h = splitmix64(h ^ tag ^ arena.size());
+  for (const auto& clause : arena)
+  {
+    h = splitmix64(h ^ (0xc1a05e00ULL + clause.size()));
+    for (const Lit& l : clause) h = splitmix64(h ^ l.toInt());
+  }
+  return h;
+}
+
+uint64_t SkolemFCInt::SklFCInt::clauses_hash() const
+{
+  uint64_t h = splitmix64(nvars);
+  h = mix_clauses(h, clauses, 4ULL << 40);
+  h = splitmix64(h ^ n_context_vars);
+  return mix_clauses(h, context_clauses, 5ULL << 40);
+}
+
+uint64_t SkolemFCInt::SklFCInt::formula_hash() const
+{
+  uint64_t h = clauses_hash();
+  h = mix_vars(h, forall_vars, 1ULL << 40);
+  h = mix_vars(h, exists_vars, 2ULL << 40);
+  return mix_vars(h, defined_vars, 3ULL << 40);
+}
+
+void SkolemFCInt::SklFCInt::set_defined_vars(const vector<uint32_t>& defined)
+{
+  vector<char> is_defined(nvars, 0);
+  for (uint32_t v : defined) is_defined[v] = 1;
+  vector<uint32_t> rest;
+  for (uint32_t v : exists_vars)
+    (is_defined[v] ? defined_vars : rest).push_back(v);
+  exists_vars.swap(rest);
+}
+
 bool SkolemFCInt::SklFCInt::add_forall_var(uint32_t a_var)
 {
   forall_vars.push_back(a_var);
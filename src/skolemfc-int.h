@@ -41,6 +41,7 @@
 #include <random>
 #include <vector>
 
+#include "clause-arena.h"
 #include "skolemfc.h"
 
 using CMSat::Lit;
@@ -72,6 +73,16 @@ typedef uint16_t WeightPrec;
 
 typedef unsigned char value;
 
+// Part of F whose non-X variables are connected through shared clauses. F is
+// the conjunction of its components, which only share X, so for every X
+// assignment the count of F is the product of the counts of the components.
+struct YComponent
+{
+  vector<uint32_t> vars;  // every non-X variable of the component
+  vector<uint32_t> exists_vars;
+  vector<uint32_t> clause_ids;
+};
+
 struct SklFCInt
 {
   SklFCInt(const double _epsilon,
@@ -97,13 +108,25 @@ struct SklFCInt
   void check_ready() const;
 
   uint32_t nVars() const { return nvars; }
+  // Variables of F together with those only the context clauses use
+  uint32_t nFVars() const { return nvars + n_context_vars; }
   uint32_t nGVars() const { return n_g_vars; }
 
   void set_n_cls(uint32_t n_cls);
   const char* get_version_info() const;
   const char* get_compilation_env() const;
   void create_g_formula();
-  void print_formula(const vector<vector<Lit>>& formula);
+  // Moves every Y variable that is functionally defined by X and the
+  // remaining Y variables from exists_vars to defined_vars
+  uint32_t eliminate_defined_vars(uint64_t max_confl);
+  vector<YComponent> y_components(vector<uint32_t>& x_only_clauses) const;
+  // Identifies the formula a checkpoint was taken on
+  uint64_t formula_hash() const;
+  // Only F's clauses, which is all the count engine depends on
+  uint64_t clauses_hash() const;
+  // Takes the outcome of an earlier eliminate_defined_vars() on this formula
+  void set_defined_vars(const vector<uint32_t>& defined);
+  void print_formula(const FormulaView& formula);
 
   uint32_t nvars = 0;
   uint32_t n_g_vars = 0;
@@ -122,9 +145,17 @@ struct SklFCInt
   mpz_t prod_precision;
   uint64_t num_cl_added = 0;
   uint32_t verbosity;
-  vector<vector<Lit>> clauses;
-  vector<vector<Lit>> g_formula_clauses;
+  ClauseArena clauses;
+  ClauseArena g_formula_clauses;
+  // Set when this instance counts one Y-component of a larger formula: the
+  // clauses of the other components, over variables numbered from nvars on.
+  // They restrict X in G but are never counted over.
+  ClauseArena context_clauses;
+  uint32_t n_context_vars = 0;
   vector<uint32_t> exists_vars;
+  // Y variables fixed by X and exists_vars: they add no freedom to F, so
+  // they are primed in G but not part of |Y|
+  vector<uint32_t> defined_vars;
   vector<uint32_t> forall_vars;
   std::vector<Lit> new_clause, diff_clause;
   uint64_t logcount = 0;
@@ -0,0 +1,176 @@
+/******************************************
+ SkolemFC
+
+ Copyright (C) 2024, Arijit Shaw, Brendan Juba, and Kuldeep S. Meel.
+
+ All rights reserved.
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+***********************************************/
+
+// Combines the files of `skolemfc --shard i/n` runs into one estimate.
+// Shard i holds sampling rounds i, i + n, i + 2n, ... of the single-run
+// sequence, so interleaving the shards restores that sequence; the DKLR
+// stopping rule is then applied to it exactly as a single run would,
+// up to the first round no shard has, and so is the check that fails a
+// run whose oracle error could exceed the guarantee.
+
+#include <gmpxx.h>
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "checkpoint.h"
+
+using namespace SkolemFCInt;
+using std::cerr;
+using std::cout;
+using std::endl;
+using std::string;
+
+int main(int argc, char** argv)
+{
+  if (argc < 2)
+  {
+    cerr << "Usage: skolemfc-merge shard-file..." << endl;
+    return 1;
+  }
+
+  std::vector<Checkpoint> shards(argc - 1);
+  for (int i = 1; i < argc; i++)
+  {
+    if (!shards[i - 1].read(argv[i]))
+    {
+      cerr << "ERROR: could not read shard file '" << argv[i] << "'" << endl;
+      return 1;
+    }
+  }
+
+  const Checkpoint& first = shards[0];
+  const uint32_t n = first.num_shards;
+  const Checkpoint* counts = NULL;
+  std::vector<bool> seen(n, false);
+  for (int i = 0; i < argc - 1; i++)
+  {
+    Checkpoint& s = shards[i];
+    // mismatch() also compares the shard, which differs by design
+    Checkpoint as_first = s;
+    as_first.shard = first.shard;
+    const string why = as_first.mismatch(first);
+    if (!why.empty())
+    {
+      cerr << "ERROR: '" << argv[i + 1] << "' is from another run: " << why
+           << endl;
+      return 1;
+    }
+    if (s.shard >= n || seen[s.shard])
+    {
+      cerr << "ERROR: '" << argv[i + 1] << "' repeats shard " << s.shard
+           << endl;
+      return 1;
+    }
+    seen[s.shard] = true;
+    if (s.shard == 0) counts = &s;
+  }
+  if (counts == NULL || !counts->have_est0 || !counts->have_s2)
+  {
+    cerr << "ERROR: Est0 and |S2| come from shard 0, which is missing or "
+            "unfinished"
+         << endl;
+    return 1;
+  }
+
+  // Back to indices of the single-run sequence
+  const uint64_t round_size = first.sample_round_size;
+  std::map<uint64_t, double> results;
+  for (const Checkpoint& s : shards)
+  {
+    for (const auto& p : s.sums.pending)
+    {
+      const uint64_t round = (p.first / round_size) * n + s.shard;
+      results[round * round_size + p.first % round_size] = p.second;
+    }
+  }
+
+  uint64_t iterations = 0, expected = 0;
+  double sum = 0;
+  for (const auto& r : results)
+  {
+    if (r.first != expected) break;
+    expected++;
+    if (r.second < 0) continue;  // short sampling round
+    sum += r.second;
+    iterations++;
+    if (sum > first.thresh) break;
+  }
+
+  cout << "c [sklfc-merge] " << shards.size() << " of " << n << " shards, "
+       << results.size() << " sample counts, reduced the first "
+       << expected << " samples" << endl;
+  if (first.num_exists > 0 && sum <= first.thresh)
+  {
+    cerr << "ERROR: the shards' samples sum to " << sum
+         << " before the first missing round, short of the threshold "
+         << first.thresh
+         << "; run the missing shards or rerun with a larger --shard-margin"
+         << endl;
+    return 1;
+  }
+
+  mpf_class count = counts->est0;
+  if (first.num_exists > 0)
+    count += (mpf_class(first.thresh) / (double)iterations)
+             * (mpf_class)counts->s2size;
+  cout << "c [sklfc-merge] iterations: " << iterations << " sum: " << sum
+       << " threshold: " << first.thresh << endl;
+  cout << "c [sklfc-merge] Est0: " << counts->est0
+       << " |S2|: " << counts->s2size << endl;
+
+  // The same guard a single run applies, over the samples of all shards
+  uint64_t oracle = 0, engine = 0;
+  for (const Checkpoint& s : shards)
+  {
+    oracle += s.oracle_samples;
+    engine += s.engine_samples;
+  }
+  const double approx_share =
+      engine > 0 ? std::min(1.0, (double)oracle / (double)engine) : 1;
+  if (first.num_exists > 0
+      && oracle_error_exceeds(count,
+                              counts->s2size,
+                              approx_share,
+                              first.epsilon_c,
+                              first.max_error_logcounter,
+                              first.approxmc_threshold))
+  {
+    cout << "c [sklfc-merge] error by model counting oracle exceeded by "
+            "guarantees, this run failed"
+         << endl;
+    cout << "c [sklfc-merge] try increasing --max-error-logcounter, "
+            "currently "
+         << first.max_error_logcounter << endl;
+    return 1;
+  }
+  cout << "s fc 2 ** " << count << endl;
+  return 0;
+}
@@ -0,0 +1,345 @@
+/******************************************
+ SkolemFC
+
+ Copyright (C) 2024, Arijit Shaw, Brendan Juba, and Kuldeep S. Meel.
+
+ All rights reserved.
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+***********************************************/
+
+// Times SkolemFC's own code, stage by stage, on synthetic formulas of
+// growing size: QDIMACS parsing (streamed, and chunked in memory), building
+// G, serializing a CNF for Ganak, copying a formula into an oracle,
+// restricting F to a sample, and the bookkeeping of samples. No oracle runs
+// inside a timed region; the count engine's one Arjun pass happens before
+// its stage is timed.
+
+#include <boost/program_options.hpp>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <string>
+#include <vector>
+
+#include <dimacsparser.h>
+#include "count-engine.h"
+#include "ganak-runner.h"
+#include "ordered-sum.h"
+#include "qdimacs-reader.h"
+#include "sample-store.h"
+#include "seed-stream.h"
+#include "skolemfc-int.h"
+#include "skolemfc.h"
+
+namespace po = boost::program_options;
+using namespace SkolemFCInt;
+using std::cout;
+using std::endl;
+using std::string;
+using std::vector;
+
+namespace {
+std::atomic<uint64_t> alloc_count{0};
+std::atomic<uint64_t> alloc_bytes{0};
+}  // namespace
+
+// Every allocation of the process is counted
+void* operator new(size_t n)
+{
+  alloc_count.fetch_add(1, std::memory_order_relaxed);
+  alloc_bytes.fetch_add(n, std::memory_order_relaxed);
+  if (void* p = malloc(n ? n : 1)) return p;
+  throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+
+namespace {
+
+// Random 3-CNF over X and Y, one X per three Y variables, every clause
+// with at least one Y literal, at a clause/variable ratio that stays
+// satisfiable
+struct Synthetic
+{
+  uint32_t nvars = 0;
+  vector<uint32_t> xs, ys;
+  ClauseArena clauses;
+};
+
+Synthetic make_formula(uint64_t num_clauses, uint64_t seed)
+{
+  Synthetic f;
+  f.nvars = std::max<uint64_t>(8, num_clauses / 3);
+  for (uint32_t v = 0; v < f.nvars; v++)
+    (v % 4 == 0 ? f.xs : f.ys).push_back(v);
+
+  uint64_t state = seed;
+  auto next = [&](uint64_t bound) {
+    state = splitmix64(state);
+    return state % bound;
+  };
+  for (uint64_t i = 0; i < num_clauses; i++)
+  {
+    f.clauses.push_lit(Lit(f.ys[next(f.ys.size())], next(2)));
+    for (uint32_t k = 1; k < 3; k++)
+      f.clauses.push_lit(Lit((uint32_t)next(f.nvars), next(2)));
+    f.clauses.end_clause();
+  }
+  return f;
+}
+
+struct Result
+{
+  double ns = 0;  // per operation, best repetition
+  double allocs = 0;
+  double alloc_bytes = 0;
+  double out_bytes = 0;
+};
+
+// Best time over reps calls of op; allocations are those of the last call
+template <class Op>
+Result measure(uint32_t reps, Op&& op)
+{
+  Result r;
+  r.ns = 1e300;
+  for (uint32_t i = 0; i < reps; i++)
+  {
+    const uint64_t count0 = alloc_count, bytes0 = alloc_bytes;
+    const auto start = std::chrono::steady_clock::now();
+    const uint64_t out = op();
+    const double ns = std::chrono::duration<double, std::nano>(
+                          std::chrono::steady_clock::now() - start)
+                          .count();
+    r.ns = std::min(r.ns, ns);
+    r.allocs = (double)(alloc_count - count0);
+    r.alloc_bytes = (double)(alloc_bytes - bytes0);
+    r.out_bytes = (double)out;
+  }
+  return r;
+}
+
+void print_row(const string& stage, uint64_t size, double per, const Result& r)
+{
+  cout << std::left << std::setw(14) << stage << std::right << std::setw(10)
+       << size << std::fixed << std::setprecision(1) << std::setw(12)
+       << r.ns / per << std::setw(12) << r.allocs << std::setw(14)
+       << r.alloc_bytes / 1024 << std::setw(12) << r.out_bytes / 1024
+       << endl;
+}
+
+}  // namespace
+
+int main(int argc, char** argv)
+{
+  uint64_t min_clauses = 1000, max_clauses = 1000000;
+  uint32_t reps = 5, samples = 256, threads = 4;
+  string only;
+
+  po::options_description opts("skolemfc-microbench options");
+  opts.add_options()("help,h", "Prints help")(
+      "min-clauses",
+      po::value(&min_clauses)->default_value(min_clauses),
+      "Clauses of the smallest formula")(
+      "max-clauses",
+      po::value(&max_clauses)->default_value(max_clauses),
+      "Clauses of the largest formula; sizes grow tenfold")(
+      "reps",
+      po::value(&reps)->default_value(reps),
+      "Repetitions of every measurement, the fastest is reported")(
+      "samples",
+      po::value(&samples)->default_value(samples),
+      "Samples per repetition of the restrict and samples stages")(
+      "threads",
+      po::value(&threads)->default_value(threads),
+      "Threads of the parse-mapped stage")(
+      "stage",
+      po::value(&only),
+      "Run only this stage: parse (with parse-mapped), g-formula, "
+      "cnf-text, formula-copy, restrict or samples");
+  po::variables_map vm;
+  try
+  {
+    po::store(po::parse_command_line(argc, argv, opts), vm);
+    po::notify(vm);
+  }
+  catch (const po::error& e)
+  {
+    std::cerr << "ERROR: " << e.what() << endl;
+    return 1;
+  }
+  if (vm.count("help"))
+  {
+    cout << opts << endl;
+    return 0;
+  }
+  auto wanted = [&](const string& stage) {
+    return only.empty() || only == stage;
+  };
+
+  cout << std::left << std::setw(14) << "stage" << std::right
+       << std::setw(10) << "size" << std::setw(12) << "ns/unit"
+       << std::setw(12) << "allocs/op" << std::setw(14) << "alloc KB/op"
+       << std::setw(12) << "out KB/op" << endl;
+  cout << "(unit: a clause, or a sample for the samples stage; restrict "
+          "counts clauses times samples)"
+       << endl;
+
+  // The library logs to cout, which would be timed along with the code
+  std::streambuf* log = cout.rdbuf();
+  auto quiet = [&](bool on) { cout.rdbuf(on ? nullptr : log); };
+
+  for (uint64_t m = min_clauses; m <= max_clauses; m *= 10)
+  {
+    const Synthetic f = make_formula(m, m);
+    const double per = (double)m;
+
+    if (wanted("parse"))
+    {
+      string text = "p cnf " + std::to_string(f.nvars) + " "
+                    + std::to_string(m) + "\na";
+      for (uint32_t x : f.xs) text += " " + std::to_string(x + 1);
+      text += " 0\ne";
+      for (uint32_t y : f.ys) text += " " + std::to_string(y + 1);
+      text += " 0\n";
+      const string cnf = GanakRunner::cnf_text(f.nvars, f.clauses, {});
+      text += cnf.substr(cnf.find('\n') + 1);
+
+      Result r = measure(reps, [&]() -> uint64_t {
+        FILE* in = fmemopen(&text[0], text.size(), "r");
+        SkolemFC::SklFC counter(0.8, 0.8, 1, 0);
+        SkolemFC::DimacsParser<StreamBuffer<FILE*, FN>, SkolemFC::SklFC> parser(
+            &counter, NULL, 0);
+        parser.parse_DIMACS(in, true);
+        fclose(in);
+        return text.size();
+      });
+      print_row("parse", m, per, r);
+
+      r = measure(reps, [&]() -> uint64_t {
+        SkolemFC::SklFC counter(0.8, 0.8, 1, 0);
+        string error;
+        SkolemFC::parse_qdimacs(
+            text.data(), text.size(), &counter, threads, 0, error);
+        return text.size();
+      });
+      print_row("parse-mapped", m, per, r);
+    }
+
+    if (wanted("g-formula"))
+    {
+      SklFCInt p(0.8, 0.8, 1, 0);
+      p.new_vars(f.nvars);
+      p.forall_vars = f.xs;
+      p.exists_vars = f.ys;
+      p.clauses = f.clauses;
+      quiet(true);
+      Result r = measure(reps, [&]() -> uint64_t {
+        p.create_g_formula();
+        return p.g_formula_clauses.num_lits() * sizeof(Lit);
+      });
+      quiet(false);
+      print_row("g-formula", m, per, r);
+    }
+
+    if (wanted("cnf-text"))
+    {
+      Result r = measure(reps, [&]() -> uint64_t {
+        return GanakRunner::cnf_text(f.nvars, f.clauses, f.xs).size();
+      });
+      print_row("cnf-text", m, per, r);
+    }
+
+    if (wanted("formula-copy"))
+    {
+      // What every rebuilding oracle call does: F and the sample's units,
+      // one clause at a time through a scratch vector
+      vector<Lit> units;
+      for (uint32_t x : f.xs) units.push_back(Lit(x, x % 3 == 0));
+      Result r = measure(reps, [&]() -> uint64_t {
+        vector<Lit> scratch;
+        uint64_t copied = 0;
+        FormulaView(f.clauses).with_units(units).for_each(
+            [&](ClauseRef clause) {
+              scratch.assign(clause.begin(), clause.end());
+              copied += clause.size() * sizeof(Lit);
+            });
+        return copied;
+      });
+      print_row("formula-copy", m, per, r);
+    }
+
+    auto layout = std::make_shared<SampleLayout>(f.xs, f.nvars);
+    auto random_solution = [&](uint64_t s) {
+      vector<int> solution;
+      for (uint32_t x : f.xs)
+        solution.push_back(splitmix64(s ^ x) & 1 ? (int)x + 1 : -(int)x - 1);
+      return solution;
+    };
+
+    if (wanted("restrict"))
+    {
+      quiet(true);
+      CountEngine engine;
+      engine.build(f.nvars, f.clauses, 1, 0);
+      quiet(false);
+      SampleStore store;
+      store.init(layout);
+      for (uint32_t s = 0; s < samples; s++)
+        store.append(random_solution(s), s);
+      CountEngine::Scratch scratch;
+      Residual residual;
+      Result r = measure(reps, [&]() -> uint64_t {
+        uint64_t out = 0;
+        for (uint32_t s = 0; s < samples; s++)
+        {
+          engine.restrict(store.row(s), scratch, residual);
+          out += residual.clauses.num_lits() * sizeof(Lit);
+        }
+        return out;
+      });
+      print_row("restrict", m, per * samples, r);
+    }
+
+    if (wanted("samples"))
+    {
+      vector<vector<int>> solutions;
+      for (uint32_t s = 0; s < samples; s++)
+        solutions.push_back(random_solution(s));
+      Result r = measure(reps, [&]() -> uint64_t {
+        SampleStore store;
+        store.init(layout);
+        OrderedSum ordered(1e300);
+        for (uint32_t s = 0; s < samples; s++)
+        {
+          store.append(solutions[s], s);
+          ordered.set(s, 1.0);
+          ordered.advance();
+        }
+        return store.bytes();
+      });
+      print_row("samples", m, samples, r);
+    }
+  }
+  return 0;
+}
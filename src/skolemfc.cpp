@@ -32,11 +32,27 @@
 #include <threads.h>
 #include <unigen/unigen.h>
 
+#include <cerrno>
+#include <chrono>
 #include <cmath>
+#include <condition_variable>
 #include <iomanip>
 #include <sstream>
 
 #include "GitSHA1.h"
+#include "checkpoint.h"
+#include "count-engine.h"
+#include "exact-count.h"
+#include "ganak-runner.h"
+#include "ordered-sum.h"
+#include "phase-graph.h"
+#include "profile.h"
+#include "residual-cache.h"
+#include "sample-queue.h"
+#include "sample-store.h"
+#include "seed-stream.h"
+#include "thread-pool.h"
+#include "warm-cache.h"
 #include "skolemfc-int.h"
 #include "time_mem.h"
 
@@ -52,6 +68,25 @@ struct SkolemFC::SklFCPrivate
   SklFCPrivate(SkolemFCInt::SklFCInt* _p) : p(_p) {}
   ~SklFCPrivate() { delete p; }
   SkolemFCInt::SklFCInt* p = NULL;
+  // Shared with later runs through warm when serving
+  std::shared_ptr<const SkolemFCInt::CountEngine> engine;
+  std::shared_ptr<SkolemFCInt::ResidualCache> residual_cache =
+      std::make_shared<SkolemFCInt::ResidualCache>();
+  std::shared_ptr<SkolemFCInt::WarmCache> warm;
+  SkolemFCInt::GanakRunner ganak;
+  SkolemFCInt::SampleQueue<SkolemFCInt::IndexedSample> sample_queue{4096};
+  std::shared_ptr<const SkolemFCInt::SampleLayout> sample_layout;
+  SkolemFCInt::SampleStore samples;         // being counted
+  SkolemFCInt::SampleStore refill_samples;  // being filled in the background
+  std::unique_ptr<SkolemFCInt::ThreadPool> pool;
+  std::unique_ptr<SkolemFCInt::OrderedSum> ordered;
+  SkolemFCInt::Checkpoint checkpoint;  // counts known so far, for snapshots
+  std::mutex checkpoint_lock;
+  std::condition_variable checkpoint_wake;
+  bool checkpoint_stop = false;
+  std::thread checkpoint_thread;
+  // Set by a refill that threw, rethrown when its samples are swapped in
+  std::exception_ptr refill_error;
 };
 
 SkolemFC::SklFC::SklFC(const double epsilon_i,
@@ -62,7 +97,12 @@ SkolemFC::SklFC::SklFC(const double epsilon_i,
   skolemfc = new SklFCPrivate(
       new SkolemFCInt::SklFCInt(epsilon_i, delta_i, seed_i, verbosity));
 }
-SkolemFC::SklFC::~SklFC() { delete skolemfc; }
+SkolemFC::SklFC::~SklFC()
+{
+  finish_refill();
+  stop_checkpointing();
+  delete skolemfc;
+}
 
 uint32_t SkolemFC::SklFC::nVars() { return skolemfc->p->nvars; }
 void SkolemFC::SklFC::new_vars(uint32_t num) { skolemfc->p->nvars += num; }
@@ -72,6 +112,15 @@ bool SkolemFC::SklFC::add_clause(const std::vector<Lit>& cl)
   return skolemfc->p->add_clause(cl);
 }
 
+void SkolemFC::SklFC::add_clauses(ClauseArena&& clauses)
+{
+  ClauseArena& mine = skolemfc->p->clauses;
+  if (mine.empty())
+    mine = std::move(clauses);
+  else
+    mine.append(clauses);
+}
+
 bool SkolemFC::SklFC::add_exists_var(uint32_t var)
 {
   return skolemfc->p->add_exists_var(var);
@@ -82,11 +131,26 @@ bool SkolemFC::SklFC::add_forall_var(uint32_t var)
   return skolemfc->p->add_forall_var(var);
 }
 
+const ClauseArena& SkolemFC::SklFC::get_clauses() const
+{
+  return skolemfc->p->clauses;
+}
+
+const vector<uint32_t>& SkolemFC::SklFC::get_forall_vars() const
+{
+  return skolemfc->p->forall_vars;
+}
+
+const vector<uint32_t>& SkolemFC::SklFC::get_exists_vars() const
+{
+  return skolemfc->p->exists_vars;
+}
+
 void SkolemFC::SklFC::check_ready() { skolemfc->p->check_ready(); }
 
 void SkolemFC::SklFC::set_constants()
 {
-  start_time_skolemfc = cpuTime();
+  start_time_skolemfc = wallTime();
 
   epsilon = skolemfc->p->epsilon;
   delta = skolemfc->p->delta;
@@ -104,11 +168,22 @@ void SkolemFC::SklFC::set_constants()
   thresh *= (double)skolemfc->p->exists_vars.size();
 
   cout << "c [sklfc] threshold (x |Y|) is set to: " << thresh << endl;
+
+  target_sum = thresh.get_d();
+  if (num_shards > 1)
+  {
+    // Every shard runs to its share of the threshold, plus a margin so the
+    // merged prefix, which ends at the first round some shard lacks, still
+    // crosses the whole threshold
+    target_sum = target_sum / num_shards * (1 + shard_margin);
+    cout << "c [sklfc] shard " << shard_index << "/" << num_shards
+         << " runs to a sum of " << target_sum << endl;
+  }
 }
 
 bool SkolemFC::SklFC::show_count()
 {
-  if (skolemfc->p->verbosity < 1)
+  if (skolemfc->p->verbosity < 1 && !progress_callback)
     return false;
   else if (iteration == next_iter_to_show_output)
   {
@@ -128,7 +203,7 @@ mpf_class SkolemFC::SklFC::get_current_estimate()
 
 double SkolemFC::SklFC::get_progress()
 {
-  mpf_class x = 100 * log_skolemcount / thresh;
+  mpf_class x = 100 * log_skolemcount / target_sum;
   return x.get_d();
 }
 
@@ -275,8 +350,7 @@ mpz_class SkolemFC::SklFC::get_est0()
     cout << "c [sklfc] Employing Ganak to count F formula" << endl;
     est0 -= count_using_ganak(skolemfc->p->nVars(),
                               skolemfc->p->clauses,
-                              skolemfc->p->forall_vars,
-                              1);
+                              skolemfc->p->forall_vars);
   }
   else
   {
@@ -290,15 +364,17 @@ mpz_class SkolemFC::SklFC::get_est0()
     est0 -= absolute_count_from_appmc(c);
   }
   cout << "c [sklfc] [" << std::setprecision(2) << std::fixed
-       << (cpuTime() - start_time_skolemfc) << "]  Size of set S0: " << est0
+       << (wallTime() - start_time_skolemfc) << "]  Size of set S0: " << est0
        << endl;
 
-  est0 *= skolemfc->p->exists_vars.size();
+  // Defined outputs are still outputs for the unsat X assignments
+  est0 *=
+      skolemfc->p->exists_vars.size() + skolemfc->p->defined_vars.size();
 
   cout << "c [sklfc] Value for Est0: " << est0 << endl;
 
   cout << "c Pass Est0: " << std::setprecision(2) << std::fixed
-       << (cpuTime() - start_time_skolemfc) << endl;
+       << (wallTime() - start_time_skolemfc) << endl;
 
   return est0;
 }
@@ -311,8 +387,7 @@ mpz_class SkolemFC::SklFC::get_g_count()
     cout << "c [sklfc] Employing Ganak to count G formula" << endl;
     s1size = count_using_ganak(skolemfc->p->nGVars(),
                                skolemfc->p->g_formula_clauses,
-                               skolemfc->p->forall_vars,
-                               1);
+                               skolemfc->p->forall_vars);
   }
   else
   {
@@ -326,243 +401,100 @@ mpz_class SkolemFC::SklFC::get_g_count()
     s1size = absolute_count_from_appmc(c);
   }
   cout << "c [sklfc] [" << std::setprecision(2) << std::fixed
-       << (cpuTime() - start_time_skolemfc)
+       << (wallTime() - start_time_skolemfc)
        << "]  G formula has (projected) count: " << s1size << endl;
   cout << "c Pass Gcount: " << std::setprecision(2) << std::fixed
-       << (cpuTime() - start_time_skolemfc) << endl;
-  if (s1size == 0) okay = false;
+       << (wallTime() - start_time_skolemfc) << endl;
   return s1size;
 }
 
-string SkolemFC::SklFC::print_cnf(uint64_t num_vars,
-                                  vector<vector<Lit>> clauses,
-                                  vector<uint> projection_vars)
-{
-  string tempfile;
-  std::stringstream ss;
-
-  ss << "p cnf " << num_vars << " " << clauses.size() << endl;
-  if (projection_vars.size() > 0)
-  {
-    ss << "c p show";
-    for (uint var : projection_vars)
-    {
-      ss << " " << var + 1;
-    }
-    ss << " 0" << endl;
-  }
-  for (const auto& clause : clauses)
-  {
-    for (const Lit& lit : clause)
-    {
-      ss << lit << " ";
-    }
-    ss << "0" << endl;
-  }
-
-  string cnfContent = ss.str();
-
-  // Create a temporary file
-  char tmpFilename[] = "/tmp/ganak_input_XXXXXX";
-  tempfile = (string)tmpFilename;
-  int fd = mkstemp(tmpFilename);  // Creates a unique temporary file
-  if (fd == -1)
-  {
-    perror("mkstemp");
-    exit(EXIT_FAILURE);
-  }
-
-  // Write CNF to the temporary file
-  write(fd, cnfContent.c_str(), cnfContent.size());
-  close(fd);  // Close the file descriptor
-
-  return tempfile;
-}
-
 mpz_class SkolemFC::SklFC::count_using_ganak(uint64_t nvars,
-                                             vector<vector<Lit>> clauses,
-                                             vector<uint> projection,
-                                             uint32_t timeout)
+                                             const FormulaView& clauses,
+                                             const vector<uint>& projection)
 {
-  mpz_class ganak_count;
-
-  std::stringstream ss;
-  if (timeout == 0)
-  {
-    return 0;
-  }
-
-  ss << "p cnf " << nvars << " " << clauses.size() << endl;
-  if (projection.size() > 0)
-  {
-    ss << "c p show";
-    for (uint var : projection)
-    {
-      ss << " " << var + 1;
-    }
-    ss << " 0" << endl;
-  }
-  for (const auto& clause : clauses)
-  {
-    for (const Lit& lit : clause)
-    {
-      ss << lit << " ";
-    }
-    ss << "0" << endl;
-  }
-
-  string cnfContent = ss.str();
-
-  // Create a temporary file
-  char tmpFilename[] = "/tmp/ganak_input_XXXXXX";
-  int fd = mkstemp(tmpFilename);  // Creates a unique temporary file
-  if (fd == -1)
-  {
-    perror("mkstemp");
-    exit(EXIT_FAILURE);
-  }
-
-  // Write CNF to the temporary file
-  write(fd, cnfContent.c_str(), cnfContent.size());
-  close(fd);  // Close the file descriptor
-
-  pid_t pid;
-
-  // Create a pipe for communication between parent and child
-  int toParent[2];
-  if (pipe(toParent) == -1)
-  {
-    std::cerr << "Fork failed" << std::endl;
-    return 1;
-  }
-
-  pid = fork();
-  if (pid == -1)
-  {
-    perror("fork");
-    _exit(EXIT_FAILURE);
-  }
-
   cout << "c [sklfc] [" << std::setprecision(2) << std::fixed
-       << (cpuTime() - start_time_skolemfc) << "] counting formula using ganak"
+       << (wallTime() - start_time_skolemfc) << "] counting formula using ganak"
        << endl;
 
-  if (pid == 0)
-  {  // Child process
-    // Redirect stdout to the write-end of the pipe
-    dup2(toParent[1], STDOUT_FILENO);
-    close(toParent[0]);  // Close the read-end as it's not used by the child
-    close(toParent[1]);  // Close the write-end after duplicating
-
-    // Execute ganak with the temporary file as input
-    execlp("./ganak", "./ganak", tmpFilename, (char*)NULL);
-    perror("execlp");  // execlp only returns on error
-    exit(EXIT_FAILURE);
-  }
-  else
-  {  // Parent process
-     //     if (timeout > 0) alarm(timeout);
-    ganak_timeout = false;
-    int status;
-    close(toParent[1]);  // Close the write-end as it's not used by the parent
-
-    // Read output from ganak
-    char buffer[128];
-    string ganakOutput;
-    ssize_t count;
-    while ((count = read(toParent[0], buffer, sizeof(buffer) - 1)) > 0)
-    {
-      buffer[count] = '\0';
-      ganakOutput += buffer;
-    }
-    close(toParent[0]);  // Close the read-end after reading
-
-    // Wait for child process to finish
-    waitpid(pid, &status, 0);
-
-    // Parse ganakOutput to find the required number and store it in ganak_count
-    std::istringstream iss(ganakOutput);
-    string line;
-    bool ganak_count_line_found = false;
-    while (getline(iss, line))
-    {
-      if (line.rfind("c s exact arb int ", 0) == 0)
-      {  // Line starts with the pattern
-        string numberStr = line.substr(strlen("c s exact arb int "));
-        ganak_count.set_str(numberStr, 10);  // Set the value of ganak_count, 10
-                                             // is the base for decimal numbers
-        ganak_count_line_found = true;
-        break;
-      }
-    }
-    if (!ganak_count_line_found)
-    {
-      cout << "c [sklfc] ERROR: No Count line found from ganak" << endl;
-      exit(0);
-    }
-    if (ganak_count == 0)
-    {
-      cout << "c [sklfc] G is UNSAT. Est1 = 0" << endl;
-    }
-    if (verb >= 2) cout << "c Ganak Count " << ganak_count << endl;
-    // Remove the temporary file
-    unlink(tmpFilename);
+  GanakLimits limits;
+  limits.time_limit = ganak_time_limit;
+  limits.mem_limit = ganak_mem_limit;
+  GanakResult r = skolemfc->ganak.count(nvars, clauses, projection, limits);
+  if (r.status == GanakResult::ok)
+  {
+    if (r.count == 0) cout << "c [sklfc] G is UNSAT. Est1 = 0" << endl;
+    if (verb >= 2)
+      cout << "c Ganak Count " << r.count << " T: " << std::setprecision(2)
+           << std::fixed << r.seconds << endl;
+    return r.count;
   }
 
-  return ganak_count;
+  // The approximate count adds its (epsilon_gc, delta_gc) error to the
+  // final bound, the same as running with --exact-f/--exact-g 0
+  cout << "c [sklfc] WARNING: ganak " << GanakRunner::status_name(r.status)
+       << " after " << std::setprecision(2) << std::fixed << r.seconds
+       << "s, falling back to ApproxMC" << endl;
+  ganak_fallbacks++;
+  ApproxMC::SolCount c =
+      count_using_approxmc(nvars, clauses, projection, epsilon_gc, delta_gc);
+  return absolute_count_from_appmc(c);
 }
 
 void SkolemFC::SklFC::get_sample_num_est()
 {
-  if (static_samp)
-  {
-    sample_num_est = 500;
-    return;
-  }
-
   cout << "c [sklfc] [" << std::setprecision(2) << std::fixed
-       << (cpuTime() - start_time_skolemfc)
+       << (wallTime() - start_time_skolemfc)
        << "] estimating number of samples needed" << endl;
 
+  // Sampling starts before |S2| is known, so an UNSAT G has to be caught here
   CMSat::SATSolver cms;
-  vector<vector<Lit>> clauses;
 
   cms.new_vars(skolemfc->p->nGVars());
   vector<uint> empty;
 
-  for (auto& clause : skolemfc->p->g_formula_clauses)
+  vector<Lit> scratch;
+  for (ClauseRef clause : skolemfc->p->g_formula_clauses)
   {
-    clauses.push_back(clause);
-    cms.add_clause(clause);
+    scratch.assign(clause.begin(), clause.end());
+    cms.add_clause(scratch);
   }
 
+  ProfileScope solve_span(Probe::cms_solve);
   auto res = cms.solve();
+  solve_span.stop();
+  if (res == CMSat::l_False)
+  {
+    cout << "c Unsat G" << endl;
+    okay = false;
+    return;
+  }
+
+  if (static_samp)
+  {
+    sample_num_est = 500;
+    return;
+  }
 
   vector<lbool> model = cms.get_model();
-  vector<Lit> new_clause;
+  vector<Lit> x_units;
 
   for (auto var : skolemfc->p->forall_vars)
   {
-    new_clause.clear();
     if (model[var] == CMSat::l_True)
     {
-      new_clause.push_back(Lit(var, false));
+      x_units.push_back(Lit(var, false));
     }
     else
     {
       assert(model[var] == CMSat::l_False);
-      new_clause.push_back(Lit(var, true));
+      x_units.push_back(Lit(var, true));
     }
-    clauses.push_back(new_clause);
-  }
-
-  if (res == CMSat::l_False)
-  {
-    cout << "c Unsat G" << endl;
   }
+  FormulaView clauses =
+      FormulaView(skolemfc->p->g_formula_clauses).with_units(x_units);
 
   cout << "c [sklfc] [" << std::setprecision(2) << std::fixed
-       << (cpuTime() - start_time_skolemfc)
+       << (wallTime() - start_time_skolemfc)
        << "] got a solution by CMS for estimating, now counting that" << endl;
 
   ApproxMC::SolCount c;
@@ -572,7 +504,7 @@ void SkolemFC::SklFC::get_sample_num_est()
   c = count_using_approxmc(skolemfc->p->nGVars(), clauses, empty, 4.66, 0.7);
 
   cout << "c [sklfc] [" << std::setprecision(2) << std::fixed
-       << (cpuTime() - start_time_skolemfc)
+       << (wallTime() - start_time_skolemfc)
        << "] Estimated count from each it: " << c.cellSolCount << " * 2 ** "
        << c.hashCount << endl;
 
@@ -581,7 +513,7 @@ void SkolemFC::SklFC::get_sample_num_est()
   sample_num_est = (int)(thresh.get_d() / (c.hashCount + log2(c.cellSolCount)));
 
   cout << "c [sklfc] [" << std::setprecision(2) << std::fixed
-       << (cpuTime() - start_time_skolemfc)
+       << (wallTime() - start_time_skolemfc)
        << "] approximated number of iterations: " << sample_num_est << endl;
 
   sample_num_est =
@@ -591,42 +523,93 @@ void SkolemFC::SklFC::get_sample_num_est()
       * multisample;
 
   cout << "c Pass SizeEst: " << std::setprecision(2) << std::fixed
-       << (cpuTime() - start_time_skolemfc) << endl;
+       << (wallTime() - start_time_skolemfc) << endl;
 }
 
-void SkolemFC::SklFC::unigen_callback(const vector<int>& solution, void*)
+void SkolemFC::SklFC::init_sample_stores()
 {
-  // std::lock_guard<std::mutex> lock(vec_mutex);
-  if (verb > 2)
-    cout << "c Generated Sample size now:" << samples_from_unisamp.size()
+  skolemfc->sample_layout = std::make_shared<const SampleLayout>(
+      skolemfc->p->forall_vars, skolemfc->p->nVars());
+  skolemfc->samples.init(skolemfc->sample_layout, sample_spill_dir);
+  skolemfc->refill_samples.init(skolemfc->sample_layout, sample_spill_dir);
+  if (skolemfc->p->verbosity >= 1)
+  {
+    cout << "c [sklfc] samples packed to "
+         << skolemfc->sample_layout->words_per_row * 8 << " bytes each"
+         << (sample_spill_dir.empty() ? ""
+                                      : ", spilled to files in "
+                                            + sample_spill_dir)
          << endl;
-  samples_from_unisamp.push_back(solution);
+  }
 }
 
-void SkolemFC::SklFC::get_samples_multithread(uint64_t samples_needed)
+void SkolemFC::SklFC::unigen_callback(const vector<int>& solution,
+                                      uint64_t index,
+                                      SampleStore* out)
 {
-  for (uint i = 0; i < numthreads; ++i)
+  if (out != NULL)
   {
-    threads.push_back(
-        std::thread(&SklFC::get_samples, this, samples_needed / numthreads, i));
+    if (verb > 2)
+      cout << "c Generated Sample size now:" << out->size() << endl;
+    out->append(solution, index);
+    return;
   }
-  for (auto& thread : threads)
+
+  // Stream the sample straight to the counting workers; a full queue
+  // pushes back on the sampler until a counter catches up
+  const SampleLayout& layout = *skolemfc->sample_layout;
+  IndexedSample sample;
+  sample.index = index;
+  sample.bits.resize(layout.words_per_row);
+  layout.pack(solution, sample.bits.data());
+  if (!skolemfc->sample_queue.try_push(sample))
   {
-    thread.join();
+    ProfileScope wait(Probe::queue_full);
+    while (!skolemfc->sample_queue.try_push(sample))
+    {
+      if (skolemfc->pool->cancelled()) return;
+      std::this_thread::yield();
+    }
   }
+  samples_generated++;
 }
 
-void SkolemFC::SklFC::get_samples(uint64_t samples_needed, int _seed)
+void SkolemFC::SklFC::get_samples_multithread(uint64_t samples_needed)
 {
-  //{std::lock_guard<std::mutex> lock(cout_mutex); }
+  auto& pool = *skolemfc->pool;
+  const uint64_t rounds =
+      std::max<uint64_t>(1, (samples_needed + sample_round_size - 1)
+                                / sample_round_size);
+  const uint64_t first_round = next_round;
+  next_round += rounds;
+
+  // Rounds are sampled in any order but laid out by round number
+  vector<SampleStore> round_samples(rounds);
+  for (uint64_t r = 0; r < rounds; r++)
+  {
+    round_samples[r].init(skolemfc->sample_layout);
+    pool.submit([this, r, first_round, &round_samples](uint32_t) {
+      get_samples(sample_round_size, first_round + r, &round_samples[r]);
+    });
+  }
+  pool.wait();
 
-  if (iteration < 2)
+  skolemfc->samples.clear();
+  for (uint64_t r = 0; r < rounds; r++)
+    skolemfc->samples.append_all(round_samples[r]);
+}
+
+uint64_t SkolemFC::SklFC::get_samples(uint64_t samples_needed,
+                                      uint64_t round,
+                                      SampleStore* out)
+{
+  if (round == 0)
     cout << "c\nc ---- [ sampling ] "
             "----------------------------------------------------------\nc\n";
 
   cout << "c [sklfc] [" << std::setprecision(2) << std::fixed
-       << (cpuTime() - start_time_skolemfc) << "] starting to get "
-       << samples_needed << " samples" << endl;
+       << (wallTime() - start_time_skolemfc) << "] starting to get "
+       << samples_needed << " samples in round " << round << endl;
 
   int oracle_verb = std::max(0, (int)verb - 2);
 
@@ -638,7 +621,8 @@ void SkolemFC::SklFC::get_samples(uint64_t samples_needed, int _seed)
   vector<uint32_t> sampling_vars_orig;
 
   ug_appmc->set_verbosity(oracle_verb);
-  ug_appmc->set_seed(iteration * _seed);
+  ug_appmc->set_seed(
+      stream_seed(seed, SeedDomain::sampling, global_round(round)));
 
   ug_appmc->set_detach_xors(1);
   ug_appmc->set_reuse_models(1);
@@ -656,13 +640,17 @@ void SkolemFC::SklFC::get_samples(uint64_t samples_needed, int _seed)
     ug_appmc->set_delta(0.1);
   }
 
-  arjun->set_seed(_seed);
+  ProfileScope prep_span(Probe::unigen_prep);
+  prep_span.add_bytes(skolemfc->p->g_formula_clauses.num_lits() * sizeof(Lit));
+  arjun->set_seed(seed);
   arjun->set_verbosity(0);
   arjun->new_vars(skolemfc->p->nGVars());
 
-  for (auto& clause : skolemfc->p->g_formula_clauses)
+  vector<Lit> scratch;
+  for (ClauseRef clause : skolemfc->p->g_formula_clauses)
   {
-    arjun->add_clause(clause);
+    scratch.assign(clause.begin(), clause.end());
+    arjun->add_clause(scratch);
   }
   arjun->set_starting_sampling_set(skolemfc->p->forall_vars);
   sampling_vars_orig = skolemfc->p->forall_vars;
@@ -700,27 +688,45 @@ void SkolemFC::SklFC::get_samples(uint64_t samples_needed, int _seed)
   vector<uint32_t> sampling_vars = arjun->get_indep_set();
   delete arjun;
 
-  unigen->set_callback([this](const vector<int>& solution,
-                              void*) { this->unigen_callback(solution, NULL); },
-                       NULL);
+  // Sample i of round r always sits at index r * sample_round_size + i of
+  // the global sequence, whichever thread produced it
+  uint64_t produced = 0;
+  const uint64_t base_index = round * sample_round_size;
+  unigen->set_callback(
+      [this, &produced, base_index, samples_needed, out](
+          const vector<int>& solution, void*) {
+        if (produced >= samples_needed) return;
+        this->unigen_callback(solution, base_index + produced, out);
+        produced++;
+      },
+      NULL);
 
   ug_appmc->set_projection_set(sampling_vars);
 
   ApproxMC::SolCount c = ug_appmc->count();
+  prep_span.stop();
   unigen->set_verb_sampler_cls(0);
   unigen->set_full_sampling_vars(skolemfc->p->forall_vars);
-  unigen->sample(&c, samples_needed);
+  {
+    ProfileScope sample_span(Probe::unigen_sample);
+    unigen->sample(&c, samples_needed);
+  }
 
   delete unigen;
   delete ug_appmc;
 
+  // A short round leaves holes in the sequence that the reduction must skip
+  for (uint64_t i = produced; i < sample_round_size; i++)
+    skolemfc->ordered->skip(base_index + i);
+
   cout << "c [sklfc] [" << std::setprecision(2) << std::fixed
-       << (cpuTime() - start_time_skolemfc) << "] generated "
-       << samples_from_unisamp.size() << " samples" << endl;
+       << (wallTime() - start_time_skolemfc) << "] generated " << produced
+       << " samples in round " << round << endl;
 
-  if (iteration < 2)
+  if (round == 0)
     cout << "c Pass Sampling: " << std::setprecision(2) << std::fixed
-         << (cpuTime() - start_time_skolemfc) << endl;
+         << (wallTime() - start_time_skolemfc) << endl;
+  return produced;
 }
 
 mpf_class SkolemFC::SklFC::get_est1(mpz_class s1size)
@@ -731,116 +737,285 @@ mpf_class SkolemFC::SklFC::get_est1(mpz_class s1size)
 bool SkolemFC::SklFC::check_if_approxmc_error_exceeds(
     mpf_class count, mpz_class _s2size, double _max_error_logcounter)
 {
-  bool check = false;
-  if (_s2size * log(1 + epsilon_c) > _max_error_logcounter * count)
+  // Only samples that went to the approximate oracle carry its error;
+  // residuals that were propagated away or enumerated are exact
+  const uint64_t oracle = oracle_samples, total = engine_samples;
+  double approx_share = 1;
+  if (persistent_count && total > 0)
+    approx_share = std::min(1.0, (double)oracle / (double)total);
+
+  const bool check = oracle_error_exceeds(count,
+                                          _s2size,
+                                          approx_share,
+                                          epsilon_c,
+                                          _max_error_logcounter,
+                                          approxmc_threshold);
+  if (check)
   {
-    if (count / _s2size < approxmc_threshold)
-      check = false;
-    else
-    {
-      check = true;
-      cout << "c [sklfc] error by model counting oracle exceeded by "
-              "guarantees, this run failed "
-           << endl;
-      cout << "c [sklfc] try increasing  --max-error-logcounter, currently "
-           << _max_error_logcounter << endl;
-    }
+    cout << "c [sklfc] error by model counting oracle exceeded by "
+            "guarantees, this run failed "
+         << endl;
+    cout << "c [sklfc] try increasing  --max-error-logcounter, currently "
+         << _max_error_logcounter << endl;
   }
   return check;
 }
 
-vector<vector<Lit>> SkolemFC::SklFC::create_formula_from_sample(
-    vector<vector<int>> samples, int sample_num)
+vector<Lit> SkolemFC::SklFC::units_from_sample(const SampleRef& sample)
+{
+  vector<Lit> units;
+  units.reserve(sample.size());
+  for (uint32_t col = 0; col < sample.size(); col++)
+    units.push_back(sample.lit(col));
+  return units;
+}
+
+double SkolemFC::SklFC::oracle_delta()
+{
+  // Fixed for every sample: a delta that follows the running sum would
+  // depend on how far the other threads have got
+  return delta_c / thresh.get_d();
+}
+
+ApproxMC::SolCount SkolemFC::SklFC::count_sample(const SampleRef& sample,
+                                                 uint64_t index)
+{
+  const double _epsilon = 4.657;
+  const double _delta = oracle_delta();
+  const uint32_t oracle_seed =
+      stream_seed(seed, SeedDomain::counting, global_index(index));
+  if (persistent_count)
+    return count_using_engine(sample, _epsilon, _delta, oracle_seed);
+
+  oracle_samples.fetch_add(1, std::memory_order_relaxed);
+  vector<uint> empty;
+  const vector<Lit> units = units_from_sample(sample);
+  const FormulaView formula =
+      FormulaView(skolemfc->p->clauses).with_units(units);
+  if (skolemfc->p->verbosity > 3) skolemfc->p->print_formula(formula);
+  return count_using_approxmc(skolemfc->p->nVars(),
+                              formula,
+                              empty,
+                              _epsilon,
+                              _delta,
+                              oracle_seed,
+                              true);
+}
+
+bool SkolemFC::SklFC::counting_cancelled() const
+{
+  return cancel_requested() || (skolemfc->pool && skolemfc->pool->cancelled());
+}
+
+double SkolemFC::SklFC::run_seconds() const
+{
+  return std::chrono::duration<double>(std::chrono::steady_clock::now()
+                                       - run_start)
+      .count();
+}
+
+void SkolemFC::SklFC::report_progress(uint64_t its, double logcount)
+{
+  if (!progress_callback || its == 0) return;
+  SklFCProgress progress;
+  progress.iterations = its;
+  progress.percent = 100 * logcount / target_sum;
+  progress.estimate = logcount / (double)its * s2size_d;
+  progress.seconds = run_seconds();
+  progress_callback(progress);
+}
+
+void SkolemFC::SklFC::sync_from_ordered()
+{
+  skolemfc->ordered->advance(true);
+  iteration = skolemfc->ordered->count();
+  log_skolemcount = skolemfc->ordered->sum();
+}
+
+void SkolemFC::SklFC::show_parallel_progress(uint64_t its, double logcount)
+{
+  if (skolemfc->p->verbosity < 1 && !progress_callback) return;
+  std::unique_lock<std::mutex> lock(cout_mutex, std::try_to_lock);
+  if (!lock.owns_lock() || its < next_iter_to_show_output) return;
+  while (next_iter_to_show_output <= its)
+    next_iter_to_show_output += (next_iter_to_show_output < 10) ? 1 : 10;
+
+  if (skolemfc->p->verbosity >= 1)
+    printf("c %10.2f %10lu %15.1f     %.2f \n",
+           (wallTime() - start_time_skolemfc),
+           its,
+           100 * logcount / target_sum,
+           logcount / (double)its * s2size_d);
+  report_progress(its, logcount);
+}
+
+void SkolemFC::SklFC::print_resource_usage()
 {
-  vector<vector<Lit>> formula = skolemfc->p->clauses;
-  vector<Lit> new_clause;
-  for (auto int_lit : samples[sample_num - sample_clearance_iteration])
+  cout << "c [sklfc] after counting: " << std::setprecision(2) << std::fixed
+       << wallTime() - start_time_skolemfc << " s wall, " << cpuTimeTotal()
+       << " s process CPU, rss " << memUsedRss() / (1024 * 1024)
+       << " MB, peak " << memUsedPeak() / (1024 * 1024) << " MB" << endl;
+  if (!skolemfc->pool) return;
+
+  const ThreadPool& pool = *skolemfc->pool;
+  cout << "c [sklfc] worker CPU T:";
+  for (uint32_t w = 0; w < pool.size(); w++) cout << " " << pool.worker_cpu(w);
+  cout << endl;
+  if (pool.min_running() < pool.size())
+    cout << "c [sklfc] --mem-limit brought counting down to "
+         << pool.min_running() << " of " << pool.size() << " threads" << endl;
+}
+
+void SkolemFC::SklFC::count_sample_on_worker(const SampleRef& sample,
+                                             uint64_t index)
+{
+  auto& pool = *skolemfc->pool;
+  auto& ordered = *skolemfc->ordered;
+  if (ordered.reached() || cancel_requested())
   {
-    bool isNegated = int_lit < 0;
-    uint32_t varIndex =
-        isNegated ? -int_lit - 1 : int_lit - 1;  // Convert to 0-based index
-    Lit literal = isNegated ? ~Lit(varIndex, false) : Lit(varIndex, false);
-    new_clause.clear();
-    new_clause.push_back(literal);
-    formula.push_back(new_clause);
+    pool.cancel();
+    return;
   }
-  if (skolemfc->p->verbosity > 3) skolemfc->p->print_formula(formula);
-  return formula;
+  // Counted before the checkpoint this run resumed from
+  if (ordered.has(index)) return;
+
+  ApproxMC::SolCount c = count_sample(sample, index);
+
+  // Samples past the stopping point are never needed, so a cancelled result
+  // can be dropped without changing the estimate
+  if (pool.cancelled() || cancel_requested()) return;
+  ordered.set(index, (double)(c.hashCount) + log2(c.cellSolCount));
+  if (ordered.advance()) pool.cancel();
+  show_parallel_progress(ordered.count(), ordered.sum());
 }
 
-void SkolemFC::SklFC::get_and_add_count_onethred(vector<vector<int>> samples)
+void SkolemFC::SklFC::get_and_add_count_multithred()
 {
-  cout << "This thread has samples: " << samples.size() << endl;
-  for (uint it = 0; it < samples.size(); it++)
+  auto& pool = *skolemfc->pool;
+  pool.reset_cancel();
+  const SampleStore& samples = skolemfc->samples;
+  for (uint64_t i = 0; i < samples.size(); i++)
   {
-    vector<vector<Lit>> sampling_formula =
-        create_formula_from_sample(samples, it);
-    ApproxMC::AppMC* appmc = new ApproxMC::AppMC;
-    appmc->new_vars(skolemfc->p->nVars());
-    for (auto& clause : sampling_formula)
+    pool.submit([this, &samples, i](uint32_t) {
+      count_sample_on_worker(samples.row(i), samples.index(i));
+    });
+  }
+  pool.wait();
+  sync_from_ordered();
+  pool.reset_cancel();
+}
+
+uint64_t SkolemFC::SklFC::pipeline_samples_wanted()
+{
+  uint64_t its = skolemfc->ordered->count();
+  double logcount = skolemfc->ordered->sum();
+  double projected;
+  if (its > 0 && logcount > 0.0001)
+    projected = target_sum * its / logcount;
+  else
+    projected = sample_num_est;
+
+  uint64_t requested = next_round * sample_round_size;
+  if (projected <= requested) return 0;
+  return (uint64_t)projected - requested;
+}
+
+void SkolemFC::SklFC::pipeline_worker(uint32_t worker)
+{
+  auto& pool = *skolemfc->pool;
+  auto& queue = skolemfc->sample_queue;
+  // Keep at least one thread counting, and start sampling again before the
+  // counters drain the queue completely
+  const uint32_t max_samplers = numthreads - 1;
+  const size_t low_water = 2 * numthreads;
+  IndexedSample sample;
+
+  while (!pool.cancelled())
+  {
+    if (cancel_requested())
     {
-      appmc->add_clause(clause);
+      pool.cancel();
+      break;
     }
-    ApproxMC::SolCount c = appmc->count();
-    double logcount_this_it = (double)c.hashCount + log2(c.cellSolCount);
+    // Runs until counting ends, so the memory limit parks it here. Never
+    // with samples queued: worker 0 may be a sampler spinning on a full
+    // queue, which only the parked workers can drain.
+    pool.throttle(worker, [&queue]() { return queue.size() > 0; });
+    size_t depth = queue.size();
+    uint64_t wanted = pipeline_samples_wanted();
+    bool starving = depth == 0 && active_samplers == 0;
+    if (depth < low_water && (wanted > 0 || starving))
     {
-      std::lock_guard<std::mutex> lock(iter_mutex);
-      if (log_skolemcount <= thresh)
+      uint32_t cur = active_samplers;
+      if (cur < max_samplers
+          && active_samplers.compare_exchange_strong(cur, cur + 1))
       {
-        iteration++;
-        log_skolemcount += logcount_this_it;
+        get_samples(sample_round_size, next_round++, NULL);
+        active_samplers--;
+        continue;
       }
     }
-    if (skolemfc->p->verbosity > 1 && iteration % 10 == 0)
-    {
-      std::lock_guard<std::mutex> lock(cout_mutex);
 
-      cout << "c [sklfc] logcount at iteration " << iteration << ": "
-           << logcount_this_it << " log_skolemcount: " << log_skolemcount
-           << endl;
+    if (!queue.try_pop(sample))
+    {
+      std::this_thread::yield();
+      continue;
     }
+    if (depth > peak_queue_depth) peak_queue_depth = depth;
+
+    count_sample_on_worker(
+        SampleRef{sample.bits.data(), skolemfc->sample_layout.get()},
+        sample.index);
   }
 }
-void SkolemFC::SklFC::get_and_add_count_multithred()
+
+void SkolemFC::SklFC::run_pipeline()
 {
-  vector<vector<vector<int>>> partitioned_solutions(numthreads);
-  size_t partition_size =
-      std::ceil(samples_from_unisamp.size() / static_cast<double>(numthreads));
+  auto& pool = *skolemfc->pool;
+  cout << "c [sklfc] [" << std::setprecision(2) << std::fixed
+       << (wallTime() - start_time_skolemfc)
+       << "] Starting pipelined sampling and counting with " << numthreads
+       << " threads" << endl;
+  cout << "c\nc ---- [ counting ] "
+          "----------------------------------------------------------\nc\n";
+  cout << "c\nc   seconds    iterations      progress         estimate \nc\n";
+
+  pool.reset_cancel();
+  active_samplers = 0;
+  samples_generated = 0;
 
-  auto it = samples_from_unisamp.begin();
-  for (uint i = 0; i < numthreads; ++i)
-  {
-    auto end = ((i + 1) * partition_size < samples_from_unisamp.size())
-                   ? it + partition_size
-                   : samples_from_unisamp.end();
-    partitioned_solutions[i] = vector<vector<int>>(it, end);
-    it = end;
-  }
   for (uint i = 0; i < numthreads; ++i)
   {
-    {
-      threads.push_back(std::thread(
-          &SklFC::get_and_add_count_onethred, this, partitioned_solutions[i]));
-    }
-    for (auto& thread : threads)
-    {
-      thread.join();
-    }
+    pool.submit([this](uint32_t worker) { pipeline_worker(worker); });
   }
+  pool.wait();
+  sync_from_ordered();
+  pool.reset_cancel();
+
+  size_t unused = skolemfc->sample_queue.size();
+  skolemfc->sample_queue.clear();
+
+  cout << "c [sklfc] pipeline: " << samples_generated
+       << " samples generated in " << next_round << " sampling rounds, "
+       << unused
+       << " left unused, peak queue depth " << peak_queue_depth << endl;
 }
 
 ApproxMC::SolCount SkolemFC::SklFC::count_using_approxmc(
     uint64_t nvars,
-    vector<vector<Lit>> clauses,
-    vector<uint> proj_vars,
+    const FormulaView& clauses,
+    const vector<uint>& proj_vars,
     double _epsilon,
-    double _delta)
+    double _delta,
+    uint32_t oracle_seed,
+    bool per_sample)
 {
   int oracle_verb = std::max(0, (int)verb - 2);
 
   ApproxMC::AppMC* appmc = new ApproxMC::AppMC;
   ArjunNS::Arjun* arjun = new ArjunNS::Arjun;
 
+  ProfileScope simp_span(Probe::arjun_simp);
   arjun->set_seed(seed);
   arjun->set_verbosity(oracle_verb);
   arjun->set_simp(1);
@@ -853,7 +1028,13 @@ ApproxMC::SolCount SkolemFC::SklFC::count_using_approxmc(
          << " delta " << std::setprecision(15) << _delta << endl;
   }
 
-  for (auto& clause : clauses) arjun->add_clause(clause);
+  // Arjun wants a vector, so every clause passes through one buffer
+  vector<Lit> scratch;
+  clauses.for_each([&](ClauseRef clause) {
+    scratch.assign(clause.begin(), clause.end());
+    arjun->add_clause(scratch);
+    simp_span.add_bytes(clause.size() * sizeof(Lit));
+  });
 
   vector<uint32_t> sampling_vars;
   vector<uint32_t> empty_occ_sampl_vars;
@@ -867,6 +1048,20 @@ ApproxMC::SolCount SkolemFC::SklFC::count_using_approxmc(
   sampling_vars = arjun->get_indep_set();
   const auto ret =
       arjun->get_fully_simplified_renumbered_cnf(sampling_vars, false, true);
+  simp_span.stop();
+
+  ApproxMC::SolCount c;
+  // The pool's flag only ends a counting round. Startup counts (S2, Est0)
+  // may overlap one on their own threads and must not see it.
+  if (per_sample ? counting_cancelled() : cancel_requested())
+  {
+    // Result would be thrown away, skip the ApproxMC call
+    delete arjun;
+    delete appmc;
+    c.hashCount = 0;
+    c.cellSolCount = 0;
+    return c;
+  }
 
   if (skolemfc->p->verbosity >= 2)
   {
@@ -875,19 +1070,24 @@ ApproxMC::SolCount SkolemFC::SklFC::count_using_approxmc(
          << ret.sampling_vars.size() << " sized ind set" << endl;
   }
 
+  ProfileScope count_span(Probe::approxmc);
   appmc->new_vars(ret.nvars);
-  for (const auto& cl : ret.cnf) appmc->add_clause(cl);
+  for (const auto& cl : ret.cnf)
+  {
+    appmc->add_clause(cl);
+    count_span.add_bytes(cl.size() * sizeof(Lit));
+  }
   sampling_vars = ret.sampling_vars;
   uint32_t offset_count_by_2_pow = ret.empty_occs;
   appmc->set_projection_set(sampling_vars);
   appmc->set_epsilon(_epsilon);
   appmc->set_delta(_delta);
+  appmc->set_seed(oracle_seed);
 
   if (_epsilon > 1) appmc->set_pivot_by_sqrt2(1);
 
   appmc->set_verbosity(oracle_verb);
 
-  ApproxMC::SolCount c;
   if (!sampling_vars.empty())
   {
     appmc->set_projection_set(sampling_vars);
@@ -899,6 +1099,7 @@ ApproxMC::SolCount SkolemFC::SklFC::count_using_approxmc(
     c.cellSolCount = 1;
   }
   c.hashCount += offset_count_by_2_pow;
+  count_span.stop();
 
   delete arjun;
   delete appmc;
@@ -912,68 +1113,314 @@ ApproxMC::SolCount SkolemFC::SklFC::count_using_approxmc(
   return c;
 }
 
-void SkolemFC::SklFC::get_and_add_count_for_a_sample()
+ApproxMC::SolCount SkolemFC::SklFC::count_using_engine(
+    const SampleRef& sample,
+    double _epsilon,
+    double _delta,
+    uint32_t oracle_seed)
 {
-  if (iteration >= samples_from_unisamp.size() + sample_clearance_iteration
-      && iteration > 1)
+  // Scratch space stays resident in each counting thread across samples
+  static thread_local CountEngine::Scratch scratch;
+  static thread_local Residual residual;
+
+  double start_time = cpuTime();
+  ProfileScope restrict_span(Probe::engine_restrict);
+  bool sat = skolemfc->engine->restrict(sample, scratch, residual);
+  restrict_span.add_bytes(residual.clauses.num_lits() * sizeof(Lit));
+  restrict_span.stop();
+  engine_restrict_time.fetch_add(cpuTime() - start_time,
+                                 std::memory_order_relaxed);
+  engine_samples.fetch_add(1, std::memory_order_relaxed);
+
+  ApproxMC::SolCount c;
+  if (!sat || counting_cancelled())
   {
-    if (numthreads > 1)
-      get_samples_multithread(sample_num_est * 0.25);
-    else
+    c.hashCount = 0;
+    c.cellSolCount = 0;
+  }
+  else if (residual.clauses.empty())
+  {
+    c.hashCount = residual.free_vars;
+    c.cellSolCount = 1;
+  }
+  else if (residual.nvars <= exact_residual_vars)
+  {
+    start_time = cpuTime();
+    ProfileScope enum_span(Probe::exact_enum);
+    c.hashCount = residual.free_vars;
+    c.cellSolCount = count_exhaustive(residual);
+    exact_enum_time.fetch_add(cpuTime() - start_time,
+                              std::memory_order_relaxed);
+    exact_enum_samples.fetch_add(1, std::memory_order_relaxed);
+  }
+  else if (residual_cache)
+  {
+    oracle_samples.fetch_add(1, std::memory_order_relaxed);
+    // The oracle is seeded from the residual rather than the sample, so a
+    // residual gets the same count whichever sample meets it first
+    static thread_local vector<uint32_t> canon_map;
+    ResidualCache& cache = *skolemfc->residual_cache;
+    ProfileScope lookup_span(Probe::residual_lookup);
+    const uint64_t h = canonicalize(residual, canon_map);
+    const bool hit = cache.lookup(h, residual, c);
+    lookup_span.stop();
+    if (!hit)
     {
-      int multisample = 500;
-      if (verb > 1)
-      {
-        cout << "c last sampling generated " << samples_from_unisamp.size()
-             << " samples. but we need more" << endl;
-        cout << "c current estimated number of iterations: "
-             << (thresh.get_d() * iteration / log_skolemcount.get_d()) << endl;
-        cout << "c asking unisamp to generate: "
-             << (uint64_t)((thresh.get_d() * iteration
-                            / log_skolemcount.get_d())
-                           - samples_from_unisamp.size())
-             << endl;
-      }
-      uint64_t new_total_sample_number =
-          (((thresh.get_d() * iteration / log_skolemcount.get_d() + multisample)
-            / multisample)
-           * multisample);
-      sample_num_est = new_total_sample_number;
-      if (new_total_sample_number > 1000) new_total_sample_number = 1000;
-      samples_from_unisamp.clear();
-      sample_clearance_iteration = iteration;
-      get_samples(new_total_sample_number, seed);
+      vector<uint> empty;
+      start_time = cpuTime();
+      c = count_using_approxmc(residual.nvars,
+                               residual.clauses,
+                               empty,
+                               _epsilon,
+                               _delta,
+                               stream_seed(seed, SeedDomain::counting, h),
+                               true);
+      cache.miss_oracle_time.fetch_add(cpuTime() - start_time,
+                                       std::memory_order_relaxed);
+      if (!counting_cancelled()) cache.insert(h, residual, c);
     }
+    c.hashCount += residual.free_vars;
   }
+  else
+  {
+    oracle_samples.fetch_add(1, std::memory_order_relaxed);
+    vector<uint> empty;
+    c = count_using_approxmc(residual.nvars,
+                             residual.clauses,
+                             empty,
+                             _epsilon,
+                             _delta,
+                             oracle_seed,
+                             true);
+    c.hashCount += residual.free_vars;
+  }
+  return c;
+}
 
-  vector<vector<Lit>> sampling_formula =
-      create_formula_from_sample(samples_from_unisamp, iteration);
-
-  ApproxMC::SolCount c;
-  vector<uint> empty;
-  double _delta;
-  if (iteration == 0 || log_skolemcount < 0.0001)
-    _delta = delta_c / thresh.get_d();
+uint64_t SkolemFC::SklFC::refill_rounds()
+{
+  double projected;
+  if (iteration > 0 && log_skolemcount > 0.0001)
+    projected = target_sum * iteration / log_skolemcount.get_d();
   else
-    _delta = 0.5 * delta_c * log_skolemcount.get_d()
-             / ((double)iteration * thresh.get_d());
-  double _epsilon = 4.657;
+    projected = sample_num_est;
 
-  c = count_using_approxmc(
-      skolemfc->p->nVars(), sampling_formula, empty, _epsilon, _delta);
+  const double requested = (double)(next_round * sample_round_size);
+  if (projected <= requested) return 0;
+  uint64_t rounds = (uint64_t)std::ceil((projected - requested)
+                                        / (double)sample_round_size);
+  return std::min(rounds, max_refill_rounds);
+}
+
+void SkolemFC::SklFC::start_refill(uint64_t rounds)
+{
+  assert(!refill_thread.joinable());
+  const uint64_t first_round = next_round;
+  next_round += rounds;
+  refill_thread = std::thread([this, first_round, rounds]() {
+    Profiler::get().name_thread("refill");
+    try
+    {
+      for (uint64_t r = first_round; r < first_round + rounds; r++)
+        get_samples(sample_round_size, r, &skolemfc->refill_samples);
+    }
+    catch (...)
+    {
+      skolemfc->refill_error = std::current_exception();
+    }
+  });
+}
+
+bool SkolemFC::SklFC::swap_in_refill()
+{
+  finish_refill();
+  if (skolemfc->refill_error)
+  {
+    std::exception_ptr e = skolemfc->refill_error;
+    skolemfc->refill_error = nullptr;
+    std::rethrow_exception(e);
+  }
+  // Only the buffers change hands, no sample is copied
+  skolemfc->samples.swap(skolemfc->refill_samples);
+  skolemfc->refill_samples.clear();
+  sample_pos = 0;
+  return !skolemfc->samples.empty();
+}
+
+void SkolemFC::SklFC::finish_refill()
+{
+  if (refill_thread.joinable()) refill_thread.join();
+}
+
+bool SkolemFC::SklFC::load_checkpoint()
+{
+  Checkpoint saved;
+  if (!saved.read(checkpoint_path))
+  {
+    cout << "c [sklfc] no usable checkpoint in " << checkpoint_path
+         << ", starting from scratch" << endl;
+    return false;
+  }
+  const string why = saved.mismatch(skolemfc->checkpoint);
+  if (!why.empty())
+  {
+    cout << "c [sklfc] WARNING: not resuming from " << checkpoint_path << ": "
+         << why << endl;
+    return false;
+  }
+
+  skolemfc->checkpoint = saved;
+  skolemfc->ordered->restore(saved.sums);
+  sync_from_ordered();
+  // The oracle-error check covers the samples of the whole run
+  oracle_samples = saved.oracle_samples;
+  engine_samples = saved.engine_samples;
+  // Rounds before the first unreduced sample are done
+  next_round = saved.sums.next / sample_round_size;
+  cout << "c [sklfc] resuming from " << checkpoint_path << " at iteration "
+       << iteration << " (" << std::setprecision(1) << std::fixed
+       << get_progress() << "%), " << saved.sums.pending.size()
+       << " counts past it" << endl;
+  return true;
+}
+
+void SkolemFC::SklFC::fill_error_guard(Checkpoint& ck) const
+{
+  ck.oracle_samples = oracle_samples;
+  ck.engine_samples = persistent_count ? (uint64_t)engine_samples : 0;
+  ck.epsilon_c = epsilon_c;
+  ck.max_error_logcounter = max_error_logcounter;
+  ck.approxmc_threshold = approxmc_threshold;
+}
+
+void SkolemFC::SklFC::write_checkpoint()
+{
+  Checkpoint ck;
+  {
+    std::lock_guard<std::mutex> lock(skolemfc->checkpoint_lock);
+    ck = skolemfc->checkpoint;
+  }
+  ck.sums = skolemfc->ordered->snapshot(next_round * sample_round_size);
+  fill_error_guard(ck);
+  if (!ck.write(checkpoint_path))
+  {
+    cout << "c [sklfc] WARNING: could not write checkpoint " << checkpoint_path
+         << ": " << strerror(errno) << endl;
+  }
+  else if (verb >= 2)
+  {
+    cout << "c [sklfc] checkpoint at iteration " << ck.sums.count << endl;
+  }
+}
+
+void SkolemFC::SklFC::write_shard_file()
+{
+  Checkpoint out;
+  {
+    std::lock_guard<std::mutex> lock(skolemfc->checkpoint_lock);
+    out = skolemfc->checkpoint;
+  }
+  out.sums = OrderedSum::Snapshot();
+  out.sums.pending =
+      skolemfc->ordered->results(0, next_round * sample_round_size);
+  fill_error_guard(out);
+  if (!out.write(shard_file))
+  {
+    cout << "c [sklfc] ERROR: could not write shard file " << shard_file
+         << ": " << strerror(errno) << endl;
+    okay = false;
+    return;
+  }
+  cout << "c [sklfc] shard " << shard_index << "/" << num_shards << ": "
+       << iteration << " iterations, sum " << log_skolemcount << ", "
+       << out.sums.pending.size() << " sample counts written to "
+       << shard_file << endl;
+}
+
+void SkolemFC::SklFC::start_checkpointing()
+{
+  if (checkpoint_path.empty()) return;
+  skolemfc->checkpoint_stop = false;
+  // Counting threads never wait for it: a snapshot only holds the
+  // reducer lock, which the workers merely try
+  skolemfc->checkpoint_thread = std::thread([this]() {
+    Profiler::get().name_thread("checkpoint");
+    std::unique_lock<std::mutex> lock(skolemfc->checkpoint_lock);
+    const auto interval = std::chrono::duration<double>(checkpoint_interval);
+    while (!skolemfc->checkpoint_stop)
+    {
+      skolemfc->checkpoint_wake.wait_for(
+          lock, interval, [this]() { return skolemfc->checkpoint_stop; });
+      if (skolemfc->checkpoint_stop) break;
+      lock.unlock();
+      write_checkpoint();
+      lock.lock();
+    }
+  });
+}
+
+void SkolemFC::SklFC::stop_checkpointing()
+{
+  if (!skolemfc->checkpoint_thread.joinable()) return;
+  {
+    std::lock_guard<std::mutex> lock(skolemfc->checkpoint_lock);
+    skolemfc->checkpoint_stop = true;
+  }
+  skolemfc->checkpoint_wake.notify_all();
+  skolemfc->checkpoint_thread.join();
+  write_checkpoint();
+}
+
+void SkolemFC::SklFC::get_and_add_count_for_a_sample()
+{
+  const SampleStore& samples = skolemfc->samples;
+  if (sample_pos >= samples.size())
+  {
+    // Only the very first round, or a projection that fell short, gets here
+    // without a refill already on its way
+    if (!refill_thread.joinable())
+      start_refill(std::max<uint64_t>(1, refill_rounds()));
+    if (!swap_in_refill())
+    {
+      cout << "c [sklfc] ERROR: sampler returned no samples" << endl;
+      okay = false;
+      return;
+    }
+  }
+
+  // Start filling the back buffer while the front one still lasts
+  if (!refill_thread.joinable()
+      && samples.size() - sample_pos <= refill_low_water)
+  {
+    uint64_t rounds = refill_rounds();
+    if (rounds > 0) start_refill(rounds);
+  }
+
+  const uint64_t index = samples.index(sample_pos);
+  if (skolemfc->ordered->has(index))
+  {
+    // Counted before the checkpoint this run resumed from
+    sample_pos++;
+    return;
+  }
+  ApproxMC::SolCount c = count_sample(samples.row(sample_pos++), index);
+  if (cancel_requested()) return;
 
   double logcount_this_it = (double)(c.hashCount) + log2(c.cellSolCount);
 
-  iteration++;
-  log_skolemcount += logcount_this_it;
+  // Same reduction as the parallel paths, so -j 1 agrees with -j N
+  skolemfc->ordered->set(index, logcount_this_it);
+  sync_from_ordered();
 
   if (show_count())
   {
-    printf("c %10.2f %10lu %15.1f     %.2f \n",
-           (cpuTime() - start_time_skolemfc),
-           iteration,
-           get_progress(),
-           get_current_estimate().get_d());
+    if (skolemfc->p->verbosity >= 1)
+      printf("c %10.2f %10lu %15.1f     %.2f \n",
+             (wallTime() - start_time_skolemfc),
+             iteration,
+             get_progress(),
+             get_current_estimate().get_d());
+    report_progress(iteration, log_skolemcount.get_d());
     //     cout << "c [sklfc] [" << std::setprecision(2) << std::fixed
     //          << (cpuTime() - start_time_skolemfc) << "] iteration:   " <<
     //          iteration
@@ -1003,49 +1450,507 @@ ApproxMC::SolCount SkolemFC::SklFC::log_count_from_absolute(mpz_class count)
 }
 
 void SkolemFC::SklFC::count()
+{
+  SklFCResult r = run();
+  if (r.status == SklFCResult::error)
+    cout << "c [sklfc] ERROR: " << r.message << endl;
+
+  // The estimate comes from skolemfc-merge
+  if (num_shards > 1 || r.status != SklFCResult::ok) return;
+
+  cout << "c\nc ---- [ result ] "
+          "------------------------------------------------------------\nc\n";
+
+  cout << "s fc 2 ** " << r.log2_count << endl;
+}
+
+SkolemFC::SklFCResult SkolemFC::SklFC::run(CancelToken cancel,
+                                           ProgressCallback progress)
+{
+  cancel_token = cancel;
+  progress_callback = progress;
+  run_start = std::chrono::steady_clock::now();
+  const double cpu_start = cpuTimeTotal();
+
+  SklFCResult r;
+  try
+  {
+    vector<YComponent> comps;
+    vector<uint32_t> x_only_clauses;
+    // A shard file holds the samples of one formula, so shards do not split
+    if (decompose && num_shards == 1)
+      comps = skolemfc->p->y_components(x_only_clauses);
+
+    if (comps.size() > 1)
+    {
+      result = count_by_components(comps, x_only_clauses);
+      r.components = comps.size();
+    }
+    else
+    {
+      result = estimate();
+      r.s2size = s2size;
+    }
+    r.log2_count = result;
+    r.est0 = s0size;
+    r.iterations = iteration;
+    if (run_failed)
+      r.status = SklFCResult::failed;
+    else if (cancel_requested() && !completed)
+      r.status = SklFCResult::cancelled;
+    else
+      r.status = SklFCResult::ok;
+  }
+  catch (const std::exception& e)
+  {
+    r.status = SklFCResult::error;
+    r.message = e.what();
+    run_failed = true;
+  }
+  r.startup_seconds = startup_seconds;
+  r.seconds = run_seconds();
+  r.cpu_seconds = cpuTimeTotal() - cpu_start;
+  r.peak_rss = memUsedPeak();
+  return r;
+}
+
+std::future<SkolemFC::SklFCResult> SkolemFC::SklFC::run_async(
+    CancelToken cancel, ProgressCallback progress)
+{
+  return std::async(std::launch::async, [this, cancel, progress]() {
+    return run(cancel, progress);
+  });
+}
+
+SkolemFC::SklFC* SkolemFC::SklFC::make_component_counter(
+    const vector<YComponent>& comps,
+    uint32_t i,
+    const vector<uint32_t>& x_only_clauses,
+    uint32_t threads)
+{
+  const SklFCInt& p = *skolemfc->p;
+  const uint32_t k = comps.size();
+
+  // Each component fails independently, so a union bound over k of them
+  // needs delta/k apiece. Epsilon stays: k sums, each within (1 +- eps) of
+  // its target, add up to within (1 +- eps) of the total.
+  SklFC* child = new SklFC(p.epsilon,
+                           p.delta / k,
+                           stream_seed(seed, SeedDomain::component, i),
+                           p.verbosity);
+  SklFCInt& cp = *child->skolemfc->p;
+
+  // X first, then the component's own variables, then those of the others
+  const uint32_t unmapped = std::numeric_limits<uint32_t>::max();
+  vector<uint32_t> var_map(p.nVars(), unmapped);
+  uint32_t next_var = 0;
+  for (uint32_t x : p.forall_vars)
+  {
+    var_map[x] = next_var;
+    cp.forall_vars.push_back(next_var++);
+  }
+  for (uint32_t v : comps[i].vars) var_map[v] = next_var++;
+  for (uint32_t y : comps[i].exists_vars) cp.exists_vars.push_back(var_map[y]);
+  cp.nvars = next_var;
+  for (uint32_t j = 0; j < k; j++)
+  {
+    if (j == i) continue;
+    for (uint32_t v : comps[j].vars) var_map[v] = next_var++;
+  }
+  cp.n_context_vars = next_var - cp.nvars;
+
+  auto copy_clause = [&](ClauseArena& target, uint32_t id) {
+    for (const Lit& l : p.clauses[id])
+      target.push_lit(Lit(var_map[l.var()], l.sign()));
+    target.end_clause();
+  };
+  for (uint32_t id : x_only_clauses) copy_clause(cp.clauses, id);
+  for (uint32_t j = 0; j < k; j++)
+  {
+    ClauseArena& target = (j == i) ? cp.clauses : cp.context_clauses;
+    for (uint32_t id : comps[j].clause_ids) copy_clause(target, id);
+  }
+
+  child->set_parameters();
+  child->numthreads = threads;
+  child->use_unisamp = use_unisamp;
+  child->exactcount_s0 = exactcount_s0;
+  child->exactcount_s2 = exactcount_s2;
+  // Est0 is taken once on the whole formula by the caller
+  child->ignore_unsat = true;
+  child->static_samp = static_samp;
+  child->noguarnatee = noguarnatee;
+  child->persistent_count = persistent_count;
+  child->residual_cache = residual_cache;
+  child->exact_residual_vars = exact_residual_vars;
+  child->pipeline = pipeline;
+  child->counting_mem_limit = counting_mem_limit;
+  child->sample_spill_dir = sample_spill_dir;
+  child->eliminate_defined = eliminate_defined;
+  child->definability_confl = definability_confl;
+  child->set_ganak(ganak_path, ganak_time_limit, ganak_mem_limit, ganak_procs);
+  child->skolemfc->warm = skolemfc->warm;
+  child->cancel_token = cancel_token;
+  if (!checkpoint_path.empty())
+    child->set_checkpoint(checkpoint_path + ".comp" + std::to_string(i),
+                          checkpoint_interval,
+                          resume);
+  child->epsilon_gc = epsilon_gc;
+  child->delta_gc = delta_gc / k;
+  child->epsilon_s = epsilon_s;
+  child->epsilon_c = epsilon_c;
+  child->delta_c = delta_c / k;
+  child->max_error_logcounter = max_error_logcounter;
+  child->verb_oracle = verb_oracle;
+  child->approxmc_threshold = approxmc_threshold;
+  return child;
+}
+
+mpf_class SkolemFC::SklFC::count_by_components(
+    const vector<YComponent>& comps, const vector<uint32_t>& x_only_clauses)
+{
+  start_time_skolemfc = wallTime();
+  const uint32_t k = comps.size();
+
+  cout << "c [sklfc] F splits into " << k << " Y-components with |Y| =";
+  for (const auto& comp : comps) cout << " " << comp.exists_vars.size();
+  cout << ", counting each on its own" << endl;
+
+  s0size = get_est0();
+  mpf_class count = s0size;
+
+  // Components run side by side and share the threads between them
+  vector<mpf_class> counts(k);
+  vector<uint64_t> iterations(k, 0);
+  std::atomic<bool> all_completed{true};
+  const uint32_t runners =
+      std::max<uint32_t>(1, std::min<uint32_t>(k, numthreads));
+  const uint32_t threads_each = std::max<uint32_t>(1, numthreads / runners);
+  std::atomic<uint32_t> next_comp{0};
+  auto run_components = [&]() {
+    uint32_t i;
+    while ((i = next_comp.fetch_add(1)) < k)
+    {
+      std::unique_ptr<SklFC> child(
+          make_component_counter(comps, i, x_only_clauses, threads_each));
+      counts[i] = child->estimate();
+      iterations[i] = child->iteration;
+      if (!child->completed) all_completed = false;
+      std::lock_guard<std::mutex> lock(cout_mutex);
+      if (child->run_failed) run_failed = true;
+      cout << "c [sklfc] Y-component " << i << " contributes 2 ** "
+           << counts[i] << endl;
+    }
+  };
+  vector<thread> runner_threads;
+  for (uint32_t r = 1; r < runners; r++)
+    runner_threads.emplace_back(run_components);
+  run_components();
+  for (auto& t : runner_threads) t.join();
+
+  completed = all_completed;
+  iteration = 0;
+  for (uint32_t i = 0; i < k; i++)
+  {
+    count += counts[i];
+    iteration += iterations[i];
+  }
+  return count;
+}
+
+mpf_class SkolemFC::SklFC::estimate()
 {
   mpf_class count;
 
+  // Taken before the definability pass, which depends on nothing else
+  const uint64_t formula_hash = skolemfc->p->formula_hash();
+
+  WarmCache* warm = skolemfc->warm.get();
+  if (eliminate_defined)
+  {
+    const uint64_t key = splitmix64(formula_hash ^ definability_confl);
+    vector<uint32_t> defined;
+    if (warm && warm->defined_vars(key, defined))
+    {
+      cout << "c [sklfc] reusing the definability split of an earlier run"
+           << endl;
+      skolemfc->p->set_defined_vars(defined);
+    }
+    else
+    {
+      skolemfc->p->eliminate_defined_vars(definability_confl);
+      if (warm) warm->set_defined_vars(key, skolemfc->p->defined_vars);
+    }
+  }
+
+  if (skolemfc->p->exists_vars.empty())
+  {
+    // One solution at most for every X assignment: nothing beyond Est0
+    cout << "c [sklfc] every Y variable is defined, nothing to sample" << endl;
+    start_time_skolemfc = wallTime();
+    completed = true;
+    s0size = get_est0();
+    return s0size;
+  }
+
   set_constants();
 
-  count = get_est0();
+  skolemfc->ordered.reset(new OrderedSum(target_sum));
+  if (numthreads > 1)
+  {
+    skolemfc->pool.reset(new ThreadPool(numthreads));
+    skolemfc->pool->set_mem_limit(counting_mem_limit * 1024 * 1024);
+  }
 
-  skolemfc->p->create_g_formula();
+  Checkpoint& ck = skolemfc->checkpoint;
+  ck.formula_hash = formula_hash;
+  ck.seed = seed;
+  ck.epsilon = epsilon;
+  ck.delta = delta;
+  ck.thresh = thresh.get_d();
+  ck.num_exists = skolemfc->p->exists_vars.size();
+  ck.sample_round_size = sample_round_size;
+  ck.oracle_flags = (use_unisamp ? 1 : 0) | (ignore_unsat ? 2 : 0)
+                    | (persistent_count ? 4 : 0) | (residual_cache ? 8 : 0)
+                    | (exactcount_s0 ? 16 : 0) | (exactcount_s2 ? 32 : 0);
+  ck.exact_residual_vars = persistent_count ? exact_residual_vars : 0;
+  ck.epsilon_gc = epsilon_gc;
+  ck.delta_gc = delta_gc;
+  ck.ganak_time_limit = ganak_time_limit;
+  ck.ganak_mem_limit = ganak_mem_limit;
+  ck.shard = shard_index;
+  ck.num_shards = num_shards;
+  if (warm && warm->counts(ck))
+    cout << "c [sklfc] reusing Est0 and |S2| of an earlier run" << endl;
+  if (resume && !checkpoint_path.empty()) load_checkpoint();
+  if (warm)
+  {
+    // Cached counts are only valid for the same oracle parameters
+    double oracle_d = oracle_delta();
+    uint64_t bits;
+    memcpy(&bits, &oracle_d, sizeof(bits));
+    skolemfc->residual_cache =
+        warm->residual_cache(splitmix64(bits ^ ((uint64_t)seed << 32)));
+  }
 
-  s2size = get_g_count();
+  // Est0 only needs F, so it overlaps G construction and the S2 count.
+  // Sampling needs G and a model of it, not |S2|, so the S2 count goes on
+  // in the background and is only waited for by Est1. Counts a resumed
+  // checkpoint already holds are not taken again.
+  std::mutex& ck_lock = skolemfc->checkpoint_lock;
+  // Declared before the graph, whose destructor waits for the phases
+  mpz_class est0;
+  PhaseGraph phases(numthreads > 1);
+  phases.add("est0", [&]() {
+    // Shards share Est0 and |S2|, shard 0 takes them for skolemfc-merge
+    if (shard_index != 0) return;
+    {
+      std::lock_guard<std::mutex> lock(ck_lock);
+      if (ck.have_est0)
+      {
+        est0 = ck.est0;
+        return;
+      }
+    }
+    est0 = get_est0();
+    // An oracle call cut short by cancellation leaves nothing to keep
+    if (cancel_requested()) return;
+    std::lock_guard<std::mutex> lock(ck_lock);
+    ck.est0 = est0;
+    ck.have_est0 = true;
+  });
+  const auto g_phase =
+      phases.add("g-formula", [&]() {
+        SklFCInt& p = *skolemfc->p;
+        const uint64_t key = p.formula_hash();
+        if (warm && warm->g_formula(key, p.g_formula_clauses, p.n_g_vars))
+        {
+          cout << "c [sklfc] reusing G of an earlier run" << endl;
+          return;
+        }
+        p.create_g_formula();
+        if (warm) warm->set_g_formula(key, p.g_formula_clauses, p.n_g_vars);
+      });
+  phases.add(
+      "s2-count",
+      [&]() {
+        if (shard_index != 0) return;
+        {
+          std::lock_guard<std::mutex> lock(ck_lock);
+          if (ck.have_s2)
+          {
+            s2size = ck.s2size;
+            s2size_d = s2size.get_d();
+            return;
+          }
+        }
+        s2size = get_g_count();
+        s2size_d = s2size.get_d();
+        if (cancel_requested()) return;
+        std::lock_guard<std::mutex> lock(ck_lock);
+        ck.s2size = s2size;
+        ck.have_s2 = true;
+      },
+      {g_phase});
+  const auto samp_phase = phases.add(
+      "sample-est",
+      [&]() {
+        {
+          std::lock_guard<std::mutex> lock(ck_lock);
+          if (ck.have_sample_num)
+          {
+            sample_num_est = ck.sample_num_est;
+            return;
+          }
+        }
+        get_sample_num_est();
+        std::lock_guard<std::mutex> lock(ck_lock);
+        ck.sample_num_est = sample_num_est;
+        ck.have_sample_num = okay;
+      },
+      {g_phase});
+  vector<PhaseGraph::Id> sampling_deps{samp_phase};
+  if (persistent_count)
+  {
+    sampling_deps.push_back(phases.add("engine", [&]() {
+      auto build = [&](CountEngine& engine) {
+        engine.build(skolemfc->p->nVars(),
+                     skolemfc->p->clauses,
+                     seed,
+                     skolemfc->p->verbosity);
+      };
+      if (warm)
+      {
+        const uint64_t key =
+            splitmix64(skolemfc->p->clauses_hash() ^ ((uint64_t)seed << 32));
+        skolemfc->engine = warm->engine(key, build);
+        return;
+      }
+      auto engine = std::make_shared<CountEngine>();
+      build(*engine);
+      skolemfc->engine = engine;
+    }));
+  }
+  phases.start();
+  for (auto id : sampling_deps) phases.wait(id);
+  if (num_shards > 1)
+    sample_num_est = std::max<uint64_t>(1, sample_num_est / num_shards);
 
-  if (okay) get_sample_num_est();
+  init_sample_stores();
+  start_checkpointing();
+  startup_seconds = run_seconds();
 
-  if (numthreads > 1)
+  if (skolemfc->ordered->reached() || cancel_requested())
+  {
+    // Resumed from a checkpoint that had already crossed the threshold
+  }
+  else if (numthreads > 1 && pipeline)
+  {
+    if (okay) run_pipeline();
+  }
+  else if (numthreads > 1)
   {
     if (okay) get_samples_multithread(sample_num_est);
-    get_and_add_count_multithred();
+    while (okay && log_skolemcount <= target_sum && !cancel_requested())
+    {
+      get_and_add_count_multithred();
+      if (log_skolemcount > target_sum || cancel_requested()) break;
+
+      skolemfc->samples.clear();
+      get_samples_multithread(sample_num_est * 0.25);
+      if (skolemfc->samples.empty())
+      {
+        cout << "c [sklfc] ERROR: sampler returned no samples" << endl;
+        okay = false;
+      }
+    }
   }
   else if (okay)
   {
-    get_samples(sample_num_est);
     cout << "c [sklfc] [" << std::setprecision(2) << std::fixed
-         << (cpuTime() - start_time_skolemfc)
+         << (wallTime() - start_time_skolemfc)
          << "] Starting to get count for each assignment" << endl;
 
     cout << "c\nc ---- [ counting ] "
             "----------------------------------------------------------\nc\n";
     cout << "c\nc   seconds    iterations      progress         estimate \nc\n";
 
-    while ((log_skolemcount <= thresh) && okay)
+    while ((log_skolemcount <= target_sum) && okay && !cancel_requested())
     {
       get_and_add_count_for_a_sample();
     }
+    finish_refill();
+  }
+
+  phases.wait_all();
+  stop_checkpointing();
+  completed = skolemfc->ordered->reached();
+  if (s2size == 0 && shard_index == 0) okay = false;
+  phases.print(cout);
+  print_resource_usage();
+  if (num_shards > 1)
+  {
+    write_shard_file();
   }
-  count += get_est1(s2size);
+  else if (!completed && cancel_requested())
+  {
+    // What the samples counted so far suggest, without any guarantee
+    s0size = est0;
+    count = est0;
+    if (okay && iteration > 0) count += get_current_estimate();
+  }
+  else
+  {
+    s0size = est0;
+    count = est0;
+    count += get_est1(s2size);
 
-  if (check_if_approxmc_error_exceeds(count, s2size, max_error_logcounter))
-    exit(0);
+    if (check_if_approxmc_error_exceeds(count, s2size, max_error_logcounter))
+      run_failed = true;
+  }
+  if (warm && okay && !cancel_requested()) warm->set_counts(ck);
 
-  cout << "c\nc ---- [ result ] "
-          "------------------------------------------------------------\nc\n";
+  if (persistent_count && engine_samples > 0)
+  {
+    double restrict_per_it = engine_restrict_time / (double)engine_samples;
+    double saved_per_it =
+        std::max(0.0, skolemfc->engine->prep_time - restrict_per_it);
+    cout << "c [sklfc] count engine: " << std::setprecision(4) << std::fixed
+         << restrict_per_it << " s/iteration restricting F, saved ~"
+         << saved_per_it << " s/iteration of preprocessing ("
+         << std::setprecision(2) << saved_per_it * (double)engine_samples
+         << " s over " << engine_samples << " iterations)" << endl;
+  }
+
+  if (ganak_fallbacks > 0)
+  {
+    cout << "c [sklfc] ganak: " << ganak_fallbacks
+         << " exact count(s) fell back to ApproxMC (epsilon-g "
+         << epsilon_gc << ", delta-g " << delta_gc << ")" << endl;
+  }
+
+  if (persistent_count && exact_enum_samples > 0)
+  {
+    cout << "c [sklfc] exact enumeration: " << exact_enum_samples
+         << " residuals with at most " << exact_residual_vars
+         << " variables counted exactly in " << std::setprecision(2)
+         << std::fixed << (double)exact_enum_time << " s, "
+         << oracle_samples << " sent to the approximate oracle" << endl;
+  }
 
-  cout << "s fc 2 ** " << count << endl;
+  const ResidualCache& cache = *skolemfc->residual_cache;
+  if (persistent_count && residual_cache && cache.lookups > 0)
+  {
+    const uint64_t hits = cache.hits, lookups = cache.lookups;
+    const uint64_t misses = lookups - hits;
+    double oracle_per_miss = misses > 0 ? cache.miss_oracle_time / misses : 0;
+    cout << "c [sklfc] residual cache: " << hits << " hits out of " << lookups
+         << " lookups (" << std::setprecision(2) << std::fixed
+         << 100.0 * hits / lookups << "%), saved ~"
+         << oracle_per_miss * (double)hits << " s of oracle calls" << endl;
+  }
+
+  return count;
 }
 
 const char* SkolemFC::SklFC::get_version_info()
@@ -1120,3 +2025,50 @@ void SkolemFC::SklFC::set_noguarntee_mode(bool _noguarnatee)
 {
   noguarnatee = _noguarnatee;
 }
+
+void SkolemFC::SklFC::set_persistent_count(bool _persistent_count)
+{
+  persistent_count = _persistent_count;
+}
+
+void SkolemFC::SklFC::set_residual_cache(bool _residual_cache)
+{
+  residual_cache = _residual_cache;
+}
+
+void SkolemFC::SklFC::set_decompose(bool _decompose)
+{
+  decompose = _decompose;
+}
+
+void SkolemFC::SklFC::set_warm_cache(
+    std::shared_ptr<SkolemFCInt::WarmCache> warm)
+{
+  skolemfc->warm = warm;
+}
+
+void SkolemFC::SklFC::set_ganak(const string& path,
+                                double time_limit,
+                                uint64_t mem_limit,
+                                uint32_t procs)
+{
+  ganak_path = path;
+  ganak_time_limit = time_limit;
+  ganak_mem_limit = mem_limit;
+  ganak_procs = std::max<uint32_t>(procs, 1);
+  skolemfc->ganak.set_binary(ganak_path);
+  skolemfc->ganak.set_max_procs(ganak_procs);
+}
+
+void SkolemFC::SklFC::set_eliminate_defined(bool _eliminate_defined,
+                                            uint64_t _definability_confl)
+{
+  eliminate_defined = _eliminate_defined;
+  definability_confl = _definability_confl;
+}
+
+void SkolemFC::SklFC::set_exact_residual_vars(uint32_t _exact_residual_vars)
+{
+  exact_residual_vars =
+      std::min<uint32_t>(_exact_residual_vars, max_exact_enum_vars);
+}
@@ -41,6 +41,11 @@
 #include <approxmc/approxmc.h>
 #include <gmpxx.h>
 
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <future>
+#include <memory>
 #include <mutex>
 #include <thread>
 
@@ -48,10 +53,65 @@ using CMSat::Lit;
 using std::string;
 using std::vector;
 
+namespace SkolemFCInt {
+struct Checkpoint;
+class ClauseArena;
+class WarmCache;
+struct YComponent;
+class FormulaView;
+class SampleStore;
+struct SampleRef;
+}
+
 namespace SkolemFC {
 
 struct SklFCPrivate;
 
+// Shared flag that stops a run early. Copies refer to the same flag, so the
+// caller keeps one and hands another to run().
+class CancelToken
+{
+ public:
+  CancelToken() : flag(std::make_shared<std::atomic<bool>>(false)) {}
+  void cancel() const { flag->store(true, std::memory_order_release); }
+  bool cancelled() const { return flag->load(std::memory_order_acquire); }
+
+ private:
+  std::shared_ptr<std::atomic<bool>> flag;
+};
+
+// Where a run stands, passed to the progress callback as samples are counted
+struct SklFCProgress
+{
+  uint64_t iterations = 0;
+  double percent = 0;   // of the stopping threshold
+  double estimate = 0;  // Est1 so far, log2
+  double seconds = 0;   // wall clock since run() started
+};
+typedef std::function<void(const SklFCProgress&)> ProgressCallback;
+
+struct SklFCResult
+{
+  enum Status
+  {
+    ok,         // log2_count is the estimate
+    failed,     // oracle error bound exceeded, log2_count is unreliable
+    cancelled,  // stopped by the token before the threshold was reached
+    error       // see message
+  };
+  Status status = error;
+  mpf_class log2_count = 0;  // log2 of the number of Skolem functions
+  mpz_class est0 = 0;        // |S0|, X assignments without any Y
+  mpz_class s2size = 0;      // |S2|, 0 when F split into Y-components
+  uint32_t components = 1;
+  uint64_t iterations = 0;
+  double startup_seconds = 0;  // until counting started
+  double seconds = 0;          // wall clock
+  double cpu_seconds = 0;      // of the whole process
+  uint64_t peak_rss = 0;       // bytes, of the whole process
+  string message;
+};
+
 struct SklFC
 {
  public:
@@ -68,24 +128,63 @@ struct SklFC
   void new_var();
   void new_vars(uint32_t num);
   bool add_clause(const std::vector<CMSat::Lit>& lits);
+  // Every clause at once, as a reader that builds the arena itself hands them
+  void add_clauses(SkolemFCInt::ClauseArena&& clauses);
   bool add_forall_var(uint32_t var);
   bool add_exists_var(uint32_t var);
+  // The formula as read, to hold the QDIMACS readers to each other
+  const SkolemFCInt::ClauseArena& get_clauses() const;
+  const std::vector<uint32_t>& get_forall_vars() const;
+  const std::vector<uint32_t>& get_exists_vars() const;
 
   void check_ready();
   void set_num_threads(int nthreads) { numthreads = nthreads; }
   void set_constants();
-  string print_cnf(uint64_t num_vars,
-                   vector<vector<Lit>> clauses,
-                   vector<uint> projection_vars);
   mpz_class get_est0();
   mpz_class get_g_count();
   mpz_class get_g_count_approxmc();
   mpz_class get_g_count_ganak();
-  void get_samples(uint64_t samples_needed = 0, int seed = 1);
+  uint64_t get_samples(uint64_t samples_needed,
+                       uint64_t round,
+                       SkolemFCInt::SampleStore* out);
   void get_samples_multithread(uint64_t samples_needed = 0);
   void get_and_add_count_for_a_sample();
+  uint64_t refill_rounds();
+  void start_refill(uint64_t rounds);
+  bool swap_in_refill();
+  void finish_refill();
+  bool load_checkpoint();
+  void write_checkpoint();
+  // What the oracle-error check needs to cover samples of earlier runs
+  void fill_error_guard(SkolemFCInt::Checkpoint& ck) const;
+  void start_checkpointing();
+  void write_shard_file();
+  uint64_t global_round(uint64_t round) const
+  {
+    return round * num_shards + shard_index;
+  }
+  uint64_t global_index(uint64_t index) const
+  {
+    return global_round(index / sample_round_size) * sample_round_size
+           + index % sample_round_size;
+  }
+  void stop_checkpointing();
   void get_and_add_count_multithred();
-  void get_and_add_count_onethred(vector<vector<int>> samples);
+  void count_sample_on_worker(const SkolemFCInt::SampleRef& sample,
+                              uint64_t index);
+  void run_pipeline();
+  void pipeline_worker(uint32_t worker);
+  void print_resource_usage();
+  uint64_t pipeline_samples_wanted();
+  ApproxMC::SolCount count_sample(const SkolemFCInt::SampleRef& sample,
+                                  uint64_t index);
+  double oracle_delta();
+  bool counting_cancelled() const;
+  bool cancel_requested() const { return cancel_token.cancelled(); }
+  double run_seconds() const;
+  void report_progress(uint64_t its, double logcount);
+  void sync_from_ordered();
+  void show_parallel_progress(uint64_t its, double logcount);
   mpf_class get_est1(mpz_class s1size);
   bool check_if_approxmc_error_exceeds(mpf_class count,
                                        mpz_class s2size,
@@ -93,21 +192,51 @@ struct SklFC
   mpf_class get_current_estimate();
   double get_progress();
   void get_sample_num_est();
-  vector<vector<Lit>> create_formula_from_sample(vector<vector<int>> samples,
-                                                 int sample_num);
-  ApproxMC::SolCount count_using_approxmc(
-      uint64_t, vector<vector<Lit>>, vector<uint>, double, double);
+  vector<Lit> units_from_sample(const SkolemFCInt::SampleRef& sample);
+  ApproxMC::SolCount count_using_approxmc(uint64_t,
+                                          const SkolemFCInt::FormulaView&,
+                                          const vector<uint>&,
+                                          double,
+                                          double,
+                                          uint32_t oracle_seed = 1,
+                                          bool per_sample = false);
+  ApproxMC::SolCount count_using_engine(const SkolemFCInt::SampleRef& sample,
+                                        double,
+                                        double,
+                                        uint32_t oracle_seed);
   mpz_class absolute_count_from_appmc(ApproxMC::SolCount);
   mpz_class count_using_ganak(uint64_t,
-                              vector<vector<Lit>>,
-                              vector<uint>,
-                              uint32_t);
+                              const SkolemFCInt::FormulaView&,
+                              const vector<uint>&);
   ApproxMC::SolCount log_count_from_absolute(mpz_class);
 
+  // Counts and prints the "s fc" line, as the command line tool does
   void count();
+  // Counts without printing the result. Logging still goes to cout, as
+  // set by the verbosity. The callback is called from counting threads, one
+  // call at a time. Errors are reported in the result, never by exiting.
+  SklFCResult run(CancelToken cancel = CancelToken(),
+                  ProgressCallback progress = ProgressCallback());
+  // run() on a thread of its own; this SklFC must outlive the future.
+  // Separate instances may run side by side.
+  std::future<SklFCResult> run_async(
+      CancelToken cancel = CancelToken(),
+      ProgressCallback progress = ProgressCallback());
+  mpf_class estimate();
+  mpf_class count_by_components(
+      const vector<SkolemFCInt::YComponent>& comps,
+      const vector<uint32_t>& x_only_clauses);
+  SklFC* make_component_counter(const vector<SkolemFCInt::YComponent>& comps,
+                                uint32_t i,
+                                const vector<uint32_t>& x_only_clauses,
+                                uint32_t threads);
 
   bool show_count();
   uint64_t get_iteration() { return iteration; }
+  // Result of count(): log2 of the number of Skolem functions, unless the
+  // oracle error bound was exceeded
+  mpf_class get_result() const { return result; }
+  bool failed() const { return run_failed; }
 
   // Set config
   void set_parameters();
@@ -117,26 +246,81 @@ struct SklFC
   void set_ignore_unsat(bool _ignore_unsat);
   void set_static_samp(bool _static_samp);
   void set_noguarntee_mode(bool _noguarnatee);
-  static void handle_alarm(int sig)
+  void set_persistent_count(bool _persistent_count);
+  void set_residual_cache(bool _residual_cache);
+  void set_exact_residual_vars(uint32_t _exact_residual_vars);
+  void set_decompose(bool _decompose);
+  void set_sample_spill(const string& dir) { sample_spill_dir = dir; }
+  void set_eliminate_defined(bool _eliminate_defined,
+                             uint64_t _definability_confl);
+  void set_pipeline(bool _pipeline) { pipeline = _pipeline; }
+  // MB of resident memory above which counting uses fewer threads
+  void set_mem_limit(uint64_t mb) { counting_mem_limit = mb; }
+  void set_checkpoint(const string& path, double interval, bool _resume)
+  {
+    checkpoint_path = path;
+    checkpoint_interval = interval;
+    resume = _resume;
+  }
+  void set_shard(uint32_t index,
+                 uint32_t count,
+                 const string& file,
+                 double margin)
   {
-    std::cout << "c Ganak Timeout occurred! Singal:" << sig << std::endl;
+    shard_index = index;
+    num_shards = count;
+    shard_file = file;
+    shard_margin = margin;
   }
+  // Reuse preprocessing, G and counts across the runs sharing warm
+  void set_warm_cache(std::shared_ptr<SkolemFCInt::WarmCache> warm);
+  void set_ganak(const string& path,
+                 double time_limit,
+                 uint64_t mem_limit,
+                 uint32_t procs);
 
  private:
   SklFCPrivate* skolemfc = NULL;
-  std::vector<std::thread> threads;
-  std::mutex cout_mutex, vec_mutex, iter_mutex;
+  std::mutex cout_mutex;
   uint64_t iteration = 0;
   mpf_class log_skolemcount = 0;
   mpf_class thresh = 1;
+  mpf_class result = 0;
+  bool run_failed = false;
+  CancelToken cancel_token;
+  ProgressCallback progress_callback;
+  std::chrono::steady_clock::time_point run_start =
+      std::chrono::steady_clock::now();
+  double startup_seconds = 0;
+  // The threshold was reached, or no sampling was needed
+  bool completed = false;
+  mpz_class s0size;
   mpz_class s2size;
+  // For progress reports, which may come before the S2 count is done
+  std::atomic<double> s2size_d{0};
   uint numthreads;
+  uint64_t counting_mem_limit = 0;  // MB, 0 for no limit
   bool use_unisamp = false;
   bool exactcount_s0 = true;
   bool exactcount_s2 = false;
   bool ignore_unsat = true;
   bool static_samp = false;
   bool noguarnatee = false;
+  bool persistent_count = true;
+  std::atomic<double> engine_restrict_time{0};
+  std::atomic<uint64_t> engine_samples{0};
+  bool residual_cache = true;
+  uint32_t exact_residual_vars = 20;
+  std::atomic<uint64_t> exact_enum_samples{0};
+  std::atomic<double> exact_enum_time{0};
+  std::atomic<uint64_t> oracle_samples{0};
+  bool pipeline = true;
+  bool decompose = true;
+  bool eliminate_defined = true;
+  uint64_t definability_confl = 1000000;
+  std::atomic<uint32_t> active_samplers{0};
+  std::atomic<uint64_t> samples_generated{0};
+  std::atomic<uint64_t> peak_queue_depth{0};
   double epsilon_gc = 0.2, delta_gc = 0.4;
   double epsilon = 0, delta = 0;
   double start_time_skolemfc, start_time_this;
@@ -151,10 +335,42 @@ struct SklFC
   uint verb_oracle = 0;
   uint approxmc_threshold = 35;
   ApproxMC::AppMC appmc_g;
-  void unigen_callback(const std::vector<int>& solution, void*);
-  vector<vector<int>> samples_from_unisamp;
-  uint32_t sample_clearance_iteration = 0;
-  bool ganak_timeout;
+  void unigen_callback(const std::vector<int>& solution,
+                       uint64_t index,
+                       SkolemFCInt::SampleStore* out);
+  void init_sample_stores();
+  // Directory for the memory-mapped sample files, empty keeps samples in RAM
+  string sample_spill_dir;
+  // Samples come in rounds of fixed size, round r seeded from --seed and r
+  // alone, so the sample sequence does not depend on the thread count
+  uint64_t sample_round_size = 500;
+  std::atomic<uint64_t> next_round{0};
+  uint64_t sample_pos = 0;
+  // A background sampler fills the back buffer (SklFCPrivate) while the
+  // front one is being counted
+  std::thread refill_thread;
+  uint64_t refill_low_water = 250;
+  uint64_t max_refill_rounds = 8;
+  // Periodic snapshots of the run, and whether to continue from one
+  string checkpoint_path;
+  double checkpoint_interval = 300;
+  bool resume = false;
+  // Shard shard_index of num_shards draws sampling rounds r with
+  // r % num_shards == shard_index of the single-run sequence and sums to
+  // target_sum, its share of thresh
+  uint32_t shard_index = 0;
+  uint32_t num_shards = 1;
+  string shard_file;
+  double shard_margin = 0.2;
+  double target_sum = 0;
+  // Exact counter runs: binary, wall-clock seconds and MB of address space
+  // per call (0 for no limit), and how many may run at once. A call that
+  // fails or hits a limit is redone with ApproxMC
+  string ganak_path = "./ganak";
+  double ganak_time_limit = 3600;
+  uint64_t ganak_mem_limit = 0;
+  uint32_t ganak_procs = 2;
+  std::atomic<uint32_t> ganak_fallbacks{0};
 };
 
 }  // namespace SkolemFC
@@ -0,0 +1,218 @@
+/******************************************
+ SkolemFC
+
+ Copyright (C) 2024, Arijit Shaw, Brendan Juba, and Kuldeep S. Meel.
+
+ All rights reserved.
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+***********************************************/
+
+#include "thread-pool.h"
+
+#include <chrono>
+#include <iostream>
+#include <string>
+
+#include "profile.h"
+#include "time_mem.h"
+
+using namespace SkolemFCInt;
+
+namespace {
+// Lets submit() from inside a task push onto the caller's own deque
+thread_local const ThreadPool* current_pool = nullptr;
+thread_local uint32_t current_worker = 0;
+}  // namespace
+
+ThreadPool::ThreadPool(uint32_t nthreads)
+{
+  if (nthreads == 0) nthreads = 1;
+  for (uint32_t i = 0; i < nthreads; i++)
+    workers.push_back(std::unique_ptr<Worker>(new Worker));
+  for (uint32_t i = 0; i < nthreads; i++)
+    threads.push_back(std::thread(&ThreadPool::worker_loop, this, i));
+  active = nthreads;
+  min_active = nthreads;
+}
+
+ThreadPool::~ThreadPool()
+{
+  {
+    std::lock_guard<std::mutex> lock(sleep_lock);
+    stop = true;
+  }
+  wake.notify_all();
+  for (auto& thread : threads) thread.join();
+}
+
+void ThreadPool::submit(Task task)
+{
+  uint32_t id;
+  if (current_pool == this)
+    id = current_worker;
+  else
+    id = next_worker.fetch_add(1, std::memory_order_relaxed) % workers.size();
+
+  {
+    std::lock_guard<std::mutex> lock(sleep_lock);
+    unfinished++;
+  }
+  {
+    std::lock_guard<std::mutex> lock(workers[id]->lock);
+    workers[id]->tasks.push_back(std::move(task));
+  }
+  {
+    // Under sleep_lock, or a worker that just found queued == 0 could miss
+    // the notify and sleep with the task queued
+    std::lock_guard<std::mutex> lock(sleep_lock);
+    queued.fetch_add(1, std::memory_order_release);
+  }
+  wake.notify_one();
+}
+
+void ThreadPool::wait()
+{
+  std::unique_lock<std::mutex> lock(sleep_lock);
+  idle.wait(lock, [this] { return unfinished == 0; });
+  if (failure)
+  {
+    std::exception_ptr e = failure;
+    failure = nullptr;
+    std::rethrow_exception(e);
+  }
+}
+
+bool ThreadPool::try_get(uint32_t id, Task& task)
+{
+  {
+    Worker& own = *workers[id];
+    std::lock_guard<std::mutex> lock(own.lock);
+    if (!own.tasks.empty())
+    {
+      task = std::move(own.tasks.back());
+      own.tasks.pop_back();
+      return true;
+    }
+  }
+
+  for (uint32_t i = 1; i < workers.size(); i++)
+  {
+    Worker& victim = *workers[(id + i) % workers.size()];
+    std::lock_guard<std::mutex> lock(victim.lock);
+    if (!victim.tasks.empty())
+    {
+      task = std::move(victim.tasks.front());
+      victim.tasks.pop_front();
+      return true;
+    }
+  }
+  return false;
+}
+
+void ThreadPool::check_memory()
+{
+  if (mem_limit == 0) return;
+  // Reading the RSS costs a file read, so do it every 50 ms at most
+  const double now = wallTime();
+  double next = next_mem_check.load(std::memory_order_relaxed);
+  if (now < next || !next_mem_check.compare_exchange_strong(next, now + 0.05))
+    return;
+
+  const uint64_t rss = memUsedRss();
+  uint32_t cur = active.load(std::memory_order_relaxed);
+  if (rss > mem_limit && cur > 1)
+  {
+    active.store(cur - 1, std::memory_order_release);
+    if (cur - 1 < min_active.load(std::memory_order_relaxed))
+    {
+      min_active.store(cur - 1, std::memory_order_relaxed);
+      std::cout << "c [sklfc] RSS " << rss / (1024 * 1024)
+                << " MB is over --mem-limit, running " << cur - 1
+                << " threads" << std::endl;
+    }
+  }
+  else if (rss < mem_limit / 5 * 4 && cur < workers.size())
+  {
+    active.store(cur + 1, std::memory_order_release);
+    wake.notify_all();
+  }
+}
+
+void ThreadPool::throttle(uint32_t worker,
+                          const std::function<bool()>& needed)
+{
+  check_memory();
+  auto stay = [&]() { return parked(worker) && !(needed && needed()); };
+  if (!stay()) return;
+  ProfileScope span(Probe::mem_wait);
+  std::unique_lock<std::mutex> lock(sleep_lock);
+  while (!stop && !cancelled() && stay())
+  {
+    wake.wait_for(lock, std::chrono::milliseconds(50));
+    lock.unlock();
+    check_memory();
+    lock.lock();
+  }
+}
+
+void ThreadPool::worker_loop(uint32_t id)
+{
+  current_pool = this;
+  current_worker = id;
+  Profiler::get().name_thread("worker " + std::to_string(id));
+  const double cpu_start = cpuTimeThread();
+
+  for (;;)
+  {
+    throttle(id);
+    Task task;
+    if (try_get(id, task))
+    {
+      queued.fetch_sub(1, std::memory_order_relaxed);
+      std::exception_ptr e;
+      if (!cancelled())
+      {
+        try
+        {
+          task(id);
+        }
+        catch (...)
+        {
+          e = std::current_exception();
+          cancel();
+        }
+      }
+
+      workers[id]->cpu.store(cpuTimeThread() - cpu_start,
+                             std::memory_order_relaxed);
+
+      std::lock_guard<std::mutex> lock(sleep_lock);
+      if (e && !failure) failure = e;
+      if (--unfinished == 0) idle.notify_all();
+      continue;
+    }
+
+    std::unique_lock<std::mutex> lock(sleep_lock);
+    wake.wait(lock, [this] {
+      return stop || queued.load(std::memory_order_acquire) > 0;
+    });
+    if (stop && queued.load(std::memory_order_acquire) == 0) return;
+  }
+}
@@ -0,0 +1,120 @@
+/******************************************
+ SkolemFC
+
+ Copyright (C) 2024, Arijit Shaw, Brendan Juba, and Kuldeep S. Meel.
+
+ All rights reserved.
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+***********************************************/
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace SkolemFCInt {
+
+// Fixed set of workers, each with its own task deque. A worker takes from the
+// back of its own deque and, once that is empty, steals from the front of the
+// others, so a straggler never holds back work that is queued behind it.
+// cancel() makes the pool drop every queued task and lets running tasks poll
+// cancelled() to stop early. A task that throws cancels the pool the same
+// way, and wait() rethrows the first such exception.
+//
+// With a memory limit set, the pool sheds concurrency instead of running out
+// of memory: while the resident set is over the limit, the highest-numbered
+// running worker parks between tasks, and once usage falls below 80% of the
+// limit a parked one resumes. Worker 0 never parks, and the others' queued
+// tasks are stolen as usual, so wait() still returns. Tasks that loop for a
+// long time call throttle() to park in the middle, with a needed() check
+// when worker 0 may come to wait on them.
+class ThreadPool
+{
+ public:
+  typedef std::function<void(uint32_t worker)> Task;
+
+  explicit ThreadPool(uint32_t nthreads);
+  ~ThreadPool();
+
+  uint32_t size() const { return workers.size(); }
+  void submit(Task task);
+  void wait();
+
+  void cancel() { cancel_flag.store(true, std::memory_order_release); }
+  void reset_cancel() { cancel_flag.store(false, std::memory_order_release); }
+  bool cancelled() const { return cancel_flag.load(std::memory_order_acquire); }
+
+  // Resident set size in bytes above which workers park, 0 for no limit
+  void set_mem_limit(uint64_t bytes) { mem_limit = bytes; }
+  // Parks worker while the limit wants it parked and needed() is false;
+  // needed() lets work that only parked workers could take unpark them
+  void throttle(uint32_t worker,
+                const std::function<bool()>& needed = nullptr);
+  // Lowest number of running workers the memory limit forced so far
+  uint32_t min_running() const
+  {
+    return min_active.load(std::memory_order_relaxed);
+  }
+  // CPU seconds worker has spent, up to its last finished task
+  double worker_cpu(uint32_t worker) const
+  {
+    return workers[worker]->cpu.load(std::memory_order_relaxed);
+  }
+
+ private:
+  struct Worker
+  {
+    std::mutex lock;
+    std::deque<Task> tasks;
+    std::atomic<double> cpu{0};
+  };
+
+  void worker_loop(uint32_t id);
+  bool try_get(uint32_t id, Task& task);
+  void check_memory();
+  bool parked(uint32_t id) const
+  {
+    return id >= active.load(std::memory_order_acquire);
+  }
+
+  std::vector<std::unique_ptr<Worker>> workers;
+  std::vector<std::thread> threads;
+  std::mutex sleep_lock;
+  std::condition_variable wake, idle;
+  std::atomic<uint64_t> queued{0};
+  uint64_t unfinished = 0;      // protected by sleep_lock
+  std::exception_ptr failure;  // protected by sleep_lock
+  std::atomic<uint32_t> next_worker{0};
+  std::atomic<bool> cancel_flag{false};
+  bool stop = false;  // protected by sleep_lock
+  uint64_t mem_limit = 0;
+  std::atomic<uint32_t> active{0}, min_active{0};
+  std::atomic<double> next_mem_check{0};
+};
+
+}  // namespace SkolemFCInt
@@ -27,15 +27,31 @@ THE SOFTWARE.
 #include <time.h>
 
 #include <cassert>
+#include <chrono>
+#include <cstdint>
 #include <fstream>
 #include <ios>
 #include <iostream>
 #include <string>
 
+// Monotonic wall-clock seconds, for everything reported as elapsed time. The
+// CPU clocks below stop while a thread waits and, for cpuTime() and
+// cpuTimeThread(), only count the calling thread.
+static inline double wallTime(void)
+{
+  return std::chrono::duration<double>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
 // note: MinGW64 defines both __MINGW32__ and __MINGW64__
 #if defined(_MSC_VER) || defined(__MINGW32__) || defined(_WIN32)
 #include <ctime>
 static inline double cpuTime(void) { return (double)clock() / CLOCKS_PER_SEC; }
+static inline double cpuTimeThread(void)
+{
+  return (double)clock() / CLOCKS_PER_SEC;
+}
 static inline double cpuTimeTotal(void)
 {
   return (double)clock() / CLOCKS_PER_SEC;
@@ -46,18 +62,29 @@ static inline double cpuTimeTotal(void)
 #include <sys/time.h>
 #include <unistd.h>
 
-static inline double cpuTime(void)
+static inline double rusageSeconds(const struct rusage& ru)
+{
+  return (double)ru.ru_utime.tv_sec + (double)ru.ru_utime.tv_usec / 1000000.0
+         + (double)ru.ru_stime.tv_sec + (double)ru.ru_stime.tv_usec / 1000000.0;
+}
+
+static inline bool threadUsage(struct rusage& ru)
 {
-  struct rusage ru;
 #ifdef RUSAGE_THREAD
-  int ret = getrusage(RUSAGE_THREAD, &ru);
+  return getrusage(RUSAGE_THREAD, &ru) == 0;
 #else
-  int ret = getrusage(RUSAGE_SELF, &ru);
+  return getrusage(RUSAGE_SELF, &ru) == 0;
 #endif
+}
 
+// User time of the calling thread (of the process where the platform has no
+// per-thread usage)
+static inline double cpuTime(void)
+{
+  struct rusage ru;
   // NOTE: This is needed because Windows' Linux subsystem returns non-zero
   // and I can't figure out a way to detect Windows.
-  if (ret != 0)
+  if (!threadUsage(ru))
   {
     return (double)clock() / CLOCKS_PER_SEC;
   }
@@ -65,78 +92,84 @@ static inline double cpuTime(void)
   return (double)ru.ru_utime.tv_sec + (double)ru.ru_utime.tv_usec / 1000000.0;
 }
 
+// User and system time of the calling thread, which is what cpuTimeTotal()
+// adds up over all threads
+static inline double cpuTimeThread(void)
+{
+  struct rusage ru;
+  if (!threadUsage(ru)) return (double)clock() / CLOCKS_PER_SEC;
+
+  return rusageSeconds(ru);
+}
+
+// User and system time of all threads of the process
 static inline double cpuTimeTotal(void)
 {
   struct rusage ru;
-  int ret = getrusage(RUSAGE_SELF, &ru);
-  assert(ret == 0);
+  if (getrusage(RUSAGE_SELF, &ru) != 0)
+    return (double)clock() / CLOCKS_PER_SEC;
 
-  return (double)ru.ru_utime.tv_sec + (double)ru.ru_utime.tv_usec / 1000000.0;
+  return rusageSeconds(ru);
 }
 
 #endif
 
 #if defined(__linux__)
-// process_mem_usage(double &, double &) - takes two doubles by reference,
-// attempts to read the system-dependent data for a process' virtual memory
-// size and resident set size, and return the results in KB.
-//
-// On failure, returns 0.0, 0.0
-static inline uint64_t memUsedTotal(double& vm_usage)
+// Resident set size of the process in bytes, 0 on failure. Reads statm, which
+// is much cheaper than stat, so the scheduler may call it between tasks.
+static inline uint64_t memUsedRss(void)
 {
-  // double& vm_usage
-  using std::ifstream;
-  using std::ios_base;
-  using std::string;
+  std::ifstream statm("/proc/self/statm");
+  uint64_t size = 0, resident = 0;
+  if (!(statm >> size >> resident)) return 0;
+  return resident * (uint64_t)sysconf(_SC_PAGESIZE);
+}
 
+// Resident set size in bytes, and the virtual memory size in bytes in
+// vm_usage. On failure, returns 0 with vm_usage 0.
+static inline uint64_t memUsedTotal(double& vm_usage)
+{
+  std::ifstream statm("/proc/self/statm");
+  uint64_t size = 0, resident = 0;
   vm_usage = 0.0;
-
-  // 'file' stat seems to give the most reliable results
-  //
-  ifstream stat_stream("/proc/self/stat", ios_base::in);
-
-  // dummy vars for leading entries in stat that we don't care about
-  //
-  string pid, comm, state, ppid, pgrp, session, tty_nr;
-  string tpgid, flags, minflt, cminflt, majflt, cmajflt;
-  string utime, stime, cutime, cstime, priority, nice;
-  string O, itrealvalue, starttime;
-
-  // the two fields we want
-  //
-  unsigned long vsize;
-  long rss;
-
-  stat_stream >> pid >> comm >> state >> ppid >> pgrp >> session >> tty_nr
-      >> tpgid >> flags >> minflt >> cminflt >> majflt >> cmajflt >> utime
-      >> stime >> cutime >> cstime >> priority >> nice >> O >> itrealvalue
-      >> starttime >> vsize >> rss;  // don't care about the rest
-
-  stat_stream.close();
-
-  long page_size_kb =
-      sysconf(_SC_PAGE_SIZE);  // in case x86-64 is configured to use 2MB pages
-  vm_usage = vsize;
-  double resident_set = (double)rss * (double)page_size_kb;
-
-  return resident_set;
+  if (!(statm >> size >> resident)) return 0;
+  const uint64_t page = sysconf(_SC_PAGESIZE);
+  vm_usage = (double)(size * page);
+  return resident * page;
 }
-#elif defined(__FreeBSD__)
+#elif defined(__FreeBSD__) || defined(__APPLE__)
 #include <sys/types.h>
-inline uint64_t memUsedTotal(double& vm_usage)
+// No cheap current RSS here, the peak is the closest upper bound
+static inline uint64_t memUsedPeak(void);
+static inline uint64_t memUsedRss(void) { return memUsedPeak(); }
+static inline uint64_t memUsedTotal(double& vm_usage)
 {
   vm_usage = 0;
-
-  struct rusage ru;
-  getrusage(RUSAGE_SELF, &ru);
-  return ru.ru_maxrss * 1024;
+  return memUsedPeak();
 }
 #else  // Windows
-static inline size_t memUsedTotal(double& vm_usage)
+static inline uint64_t memUsedRss(void) { return 0; }
+static inline uint64_t memUsedTotal(double& vm_usage)
 {
   vm_usage = 0;
   return 0;
 }
 #endif
 
+// Highest resident set size of the process so far, in bytes
+#if defined(_MSC_VER) || defined(__MINGW32__) || defined(_WIN32)
+static inline uint64_t memUsedPeak(void) { return 0; }
+#else
+static inline uint64_t memUsedPeak(void)
+{
+  struct rusage ru;
+  if (getrusage(RUSAGE_SELF, &ru) != 0) return 0;
+#if defined(__APPLE__)
+  return (uint64_t)ru.ru_maxrss;  // already in bytes
+#else
+  return (uint64_t)ru.ru_maxrss * 1024;
+#endif
+}
+#endif
+
 #endif  // TIME_MEM_H
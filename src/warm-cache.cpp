@@ -0,0 +1,113 @@
+/******************************************
+ SkolemFC
+
+ Copyright (C) 2024, Arijit Shaw, Brendan Juba, and Kuldeep S. Meel.
+
+ All rights reserved.
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+***********************************************/
+
+#include "warm-cache.h"
+
+using namespace SkolemFCInt;
+
+bool WarmCache::defined_vars(uint64_t key, vector<uint32_t>& out)
+{
+  std::lock_guard<std::mutex> guard(lock);
+  auto it = defined.map.find(key);
+  if (it == defined.map.end()) return false;
+  out = it->second;
+  return true;
+}
+
+void WarmCache::set_defined_vars(uint64_t key,
+                                 const vector<uint32_t>& defined_vars)
+{
+  std::lock_guard<std::mutex> guard(lock);
+  defined.put(key, defined_vars, max_entries);
+}
+
+std::shared_ptr<const CountEngine> WarmCache::engine(
+    uint64_t key, const std::function<void(CountEngine&)>& build)
+{
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    auto it = engines.map.find(key);
+    if (it != engines.map.end()) return it->second;
+  }
+  // Two runs missing at once both build; the second insert wins
+  auto fresh = std::make_shared<CountEngine>();
+  build(*fresh);
+  std::lock_guard<std::mutex> guard(lock);
+  engines.put(key, fresh, max_entries);
+  return fresh;
+}
+
+bool WarmCache::g_formula(uint64_t key, ClauseArena& out, uint32_t& n_g_vars)
+{
+  std::lock_guard<std::mutex> guard(lock);
+  auto it = g_formulas.map.find(key);
+  if (it == g_formulas.map.end()) return false;
+  out = it->second.clauses;
+  n_g_vars = it->second.n_g_vars;
+  return true;
+}
+
+void WarmCache::set_g_formula(uint64_t key,
+                              const ClauseArena& g,
+                              uint32_t n_g_vars)
+{
+  std::lock_guard<std::mutex> guard(lock);
+  g_formulas.put(key, GFormula{g, n_g_vars}, max_entries);
+}
+
+bool WarmCache::counts(Checkpoint& run)
+{
+  std::lock_guard<std::mutex> guard(lock);
+  auto it = count_records.map.find(run.formula_hash);
+  if (it == count_records.map.end() || !it->second.mismatch(run).empty())
+    return false;
+  const Checkpoint& saved = it->second;
+  run.have_est0 = saved.have_est0;
+  run.have_s2 = saved.have_s2;
+  run.have_sample_num = saved.have_sample_num;
+  run.est0 = saved.est0;
+  run.s2size = saved.s2size;
+  run.sample_num_est = saved.sample_num_est;
+  return true;
+}
+
+void WarmCache::set_counts(const Checkpoint& run)
+{
+  Checkpoint record = run;
+  record.sums = OrderedSum::Snapshot();
+  std::lock_guard<std::mutex> guard(lock);
+  count_records.put(record.formula_hash, std::move(record), max_entries);
+}
+
+std::shared_ptr<ResidualCache> WarmCache::residual_cache(uint64_t key)
+{
+  std::lock_guard<std::mutex> guard(lock);
+  auto it = residual_caches.map.find(key);
+  if (it != residual_caches.map.end()) return it->second;
+  auto fresh = std::make_shared<ResidualCache>();
+  residual_caches.put(key, fresh, max_entries);
+  return fresh;
+}
@@ -0,0 +1,108 @@
+/******************************************
+ SkolemFC
+
+ Copyright (C) 2024, Arijit Shaw, Brendan Juba, and Kuldeep S. Meel.
+
+ All rights reserved.
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+***********************************************/
+
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "checkpoint.h"
+#include "count-engine.h"
+#include "residual-cache.h"
+
+namespace SkolemFCInt {
+
+// Work that later runs in the same process can reuse, for --serve. Each
+// kind of entry is keyed by everything it depends on:
+//  - the definability split by the input formula and conflict budget
+//  - the count engine by F's clauses and the seed
+//  - G by the formula after the definability pass
+//  - Est0, |S2| and the sample-size estimate by the formula and parameters
+//    (a Checkpoint without sums)
+//  - residual counts by the seed and the oracle's delta alone, since a
+//    canonical residual means the same in any formula
+// Every kind keeps at most max_entries, dropping the oldest.
+class WarmCache
+{
+ public:
+  explicit WarmCache(size_t _max_entries = 16) : max_entries(_max_entries) {}
+
+  bool defined_vars(uint64_t key, vector<uint32_t>& out);
+  void set_defined_vars(uint64_t key, const vector<uint32_t>& defined);
+
+  // Built by the caller on a miss, outside the lock
+  std::shared_ptr<const CountEngine> engine(
+      uint64_t key, const std::function<void(CountEngine&)>& build);
+
+  bool g_formula(uint64_t key, ClauseArena& out, uint32_t& n_g_vars);
+  void set_g_formula(uint64_t key,
+                     const ClauseArena& g,
+                     uint32_t n_g_vars);
+
+  // Fills the counts of `run` when an earlier run had the same parameters
+  bool counts(Checkpoint& run);
+  void set_counts(const Checkpoint& run);
+
+  std::shared_ptr<ResidualCache> residual_cache(uint64_t key);
+
+ private:
+  template <typename T>
+  struct Fifo
+  {
+    std::unordered_map<uint64_t, T> map;
+    std::deque<uint64_t> order;
+    void put(uint64_t key, T entry, size_t max)
+    {
+      if (map.count(key) == 0) order.push_back(key);
+      map[key] = std::move(entry);
+      while (order.size() > max)
+      {
+        map.erase(order.front());
+        order.pop_front();
+      }
+    }
+  };
+  struct GFormula
+  {
+    ClauseArena clauses;
+    uint32_t n_g_vars = 0;
+  };
+
+  const size_t max_entries;
+  std::mutex lock;
+  Fifo<vector<uint32_t>> defined;
+  Fifo<std::shared_ptr<const CountEngine>> engines;
+  Fifo<GFormula> g_formulas;
+  Fifo<Checkpoint> count_records;
+  Fifo<std::shared_ptr<ResidualCache>> residual_caches;
+};
+
+}  // namespace SkolemFCInt
@@ -0,0 +1,158 @@
+/******************************************
+ SkolemFC
+
+ Copyright (C) 2024, Arijit Shaw, Brendan Juba, and Kuldeep S. Meel.
+
+ All rights reserved.
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+***********************************************/
+
+// Holds count_exhaustive() and its scalar path to a plain enumeration of the
+// assignments, on random residuals of every size it accepts. Clauses only
+// mention a few active variables, spread over the whole range, so that the
+// reference count stays cheap on the larger residuals.
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "exact-count.h"
+
+using namespace SkolemFCInt;
+using std::cout;
+using std::endl;
+using std::vector;
+
+namespace {
+
+const uint32_t max_active = 14;
+
+uint64_t brute_force(const Residual& r, const vector<uint32_t>& active)
+{
+  if (r.unsat) return 0;
+  uint64_t models = 0;
+  vector<char> value(r.nvars, 0);
+  for (uint64_t a = 0; a < (1ULL << active.size()); a++)
+  {
+    for (uint32_t i = 0; i < active.size(); i++)
+      value[active[i]] = (a >> i) & 1;
+    bool sat = true;
+    for (size_t c = 0; c < r.clauses.size() && sat; c++)
+    {
+      bool clause_sat = false;
+      for (const Lit& l : r.clauses[c])
+        clause_sat |= (value[l.var()] != 0) != l.sign();
+      sat = clause_sat;
+    }
+    models += sat;
+  }
+  return models << (r.nvars - active.size());
+}
+
+Residual random_residual(uint32_t nvars,
+                         std::mt19937_64& rng,
+                         vector<uint32_t>& active)
+{
+  Residual r;
+  r.nvars = nvars;
+
+  // Always include the lowest and highest variable, so that both the fixed
+  // in-word patterns and the top block bit are exercised
+  active.clear();
+  vector<uint32_t> perm(nvars);
+  for (uint32_t v = 0; v < nvars; v++) perm[v] = v;
+  std::shuffle(perm.begin(), perm.end(), rng);
+  if (nvars > 0) active.push_back(0);
+  if (nvars > 1) active.push_back(nvars - 1);
+  for (uint32_t v : perm)
+  {
+    if (active.size() >= max_active) break;
+    if (v != 0 && v != nvars - 1) active.push_back(v);
+  }
+  if (active.empty()) return r;
+
+  const uint32_t nclauses = rng() % (2 * active.size() + 2);
+  for (uint32_t c = 0; c < nclauses; c++)
+  {
+    const uint32_t width = 1 + rng() % 4;
+    for (uint32_t i = 0; i < width; i++)
+      r.clauses.push_lit(Lit(active[rng() % active.size()], rng() & 1));
+    r.clauses.end_clause();
+  }
+  return r;
+}
+
+bool check(const Residual& r,
+           const vector<uint32_t>& active,
+           const char* what,
+           uint32_t& failures)
+{
+  const uint64_t expected = brute_force(r, active);
+  const uint64_t dispatched = count_exhaustive(r);
+  const uint64_t scalar = count_exhaustive_scalar(r);
+  if (dispatched == expected && scalar == expected) return true;
+  cout << "FAIL " << what << " nvars " << r.nvars << " clauses "
+       << r.clauses.size() << ": expected " << expected << ", dispatched "
+       << dispatched << ", scalar " << scalar << endl;
+  failures++;
+  return false;
+}
+
+}  // namespace
+
+int main()
+{
+  std::mt19937_64 rng(20240611);
+  uint32_t failures = 0;
+  uint32_t checked = 0;
+  vector<uint32_t> active;
+
+  for (uint32_t nvars = 0; nvars <= max_exact_enum_vars; nvars++)
+  {
+    // Empty formula, one empty clause, and an unsat residual
+    Residual r;
+    r.nvars = nvars;
+    active.clear();
+    for (uint32_t v = 0; v < nvars && v < max_active; v++) active.push_back(v);
+    check(r, active, "empty", failures);
+    r.clauses.end_clause();
+    check(r, active, "empty clause", failures);
+    r.clauses.clear();
+    r.unsat = true;
+    check(r, active, "unsat", failures);
+    checked += 3;
+
+    // The largest sizes take a while per call, a few residuals will do
+    const uint32_t rounds = nvars <= 20 ? 30 : 2;
+    for (uint32_t i = 0; i < rounds; i++)
+    {
+      const Residual rr = random_residual(nvars, rng, active);
+      check(rr, active, "random", failures);
+      checked++;
+    }
+  }
+
+  cout << "exact-count: " << checked << " residuals, AVX2 path "
+       << (count_exhaustive_uses_avx2() ? "checked" : "not available")
+       << ", " << failures << " failures" << endl;
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,288 @@
+/******************************************
+ SkolemFC
+
+ Copyright (C) 2024, Arijit Shaw, Brendan Juba, and Kuldeep S. Meel.
+
+ All rights reserved.
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+***********************************************/
+
+// Reads every file of examples/ and a generated formula of several MB, which
+// the mapped reader cuts into chunks, both through DimacsParser and the
+// mapped reader, and compares the clauses and quantifier prefixes they hand
+// over. Then feeds both malformed inputs, which both must reject, the mapped
+// reader naming the right line.
+
+#include <dirent.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <dimacsparser.h>
+#include "clause-arena.h"
+#include "qdimacs-reader.h"
+#include "skolemfc.h"
+
+using namespace SkolemFC;
+using SkolemFCInt::ClauseArena;
+using std::cout;
+using std::endl;
+using std::string;
+using std::vector;
+
+namespace {
+
+const uint32_t threads = 4;
+
+// Both parsers log to cout and DimacsParser reports errors on cerr
+struct Quiet
+{
+  std::ostringstream err;
+  std::streambuf* out_buf = cout.rdbuf(nullptr);
+  std::streambuf* err_buf = std::cerr.rdbuf(err.rdbuf());
+  ~Quiet()
+  {
+    cout.rdbuf(out_buf);
+    std::cerr.rdbuf(err_buf);
+  }
+};
+
+bool parse_streaming(FILE* in, SklFC& counter, string& error)
+{
+  Quiet quiet;
+  DimacsParser<StreamBuffer<FILE*, FN>, SklFC> parser(&counter, NULL, 0);
+  const bool ok = parser.parse_DIMACS(in, true);
+  error = quiet.err.str();
+  return ok;
+}
+
+string same_formula(SklFC& a, SklFC& b)
+{
+  if (a.nVars() != b.nVars()) return "different numbers of variables";
+  if (a.get_forall_vars() != b.get_forall_vars())
+    return "different forall variables";
+  if (a.get_exists_vars() != b.get_exists_vars())
+    return "different exists variables";
+  const ClauseArena& ca = a.get_clauses();
+  const ClauseArena& cb = b.get_clauses();
+  if (ca.size() != cb.size()) return "different numbers of clauses";
+  for (size_t i = 0; i < ca.size(); i++)
+  {
+    if (!(ca[i] == cb[i])) return "clause " + std::to_string(i) + " differs";
+  }
+  return "";
+}
+
+bool check_file(const string& path, uint32_t& failures)
+{
+  SklFC streamed, mapped;
+  string streamed_error, mapped_error;
+  FILE* in = fopen(path.c_str(), "rb");
+  if (in == NULL)
+  {
+    cout << "FAIL " << path << ": could not open" << endl;
+    failures++;
+    return false;
+  }
+  const bool streamed_ok = parse_streaming(in, streamed, streamed_error);
+  fclose(in);
+  bool mapped_ok;
+  {
+    Quiet quiet;
+    mapped_ok = read_qdimacs_mapped(path, &mapped, threads, 0, mapped_error);
+  }
+
+  string problem;
+  if (!streamed_ok) problem = "DimacsParser failed: " + streamed_error;
+  else if (!mapped_ok) problem = "mapped reader failed: " + mapped_error;
+  else problem = same_formula(streamed, mapped);
+  if (problem.empty())
+  {
+    cout << "ok   " << path << ": " << mapped.get_clauses().size()
+         << " clauses" << endl;
+    return true;
+  }
+  cout << "FAIL " << path << ": " << problem << endl;
+  failures++;
+  return false;
+}
+
+// A few MB of random clauses over 1000 variables, with comments, a blank
+// line, CRLF line ends and quantifier lines in among the clauses
+string generated_formula(uint32_t nclauses)
+{
+  std::mt19937 rng(7);
+  const uint32_t nvars = 1000;
+  string text = "c generated\np cnf " + std::to_string(nvars) + " "
+                + std::to_string(nclauses) + "\na";
+  for (uint32_t v = 1; v <= 100; v++) text += " " + std::to_string(v);
+  text += " 0\ne";
+  for (uint32_t v = 101; v <= 900; v++) text += " " + std::to_string(v);
+  text += " 0\n";
+  for (uint32_t i = 0; i < nclauses; i++)
+  {
+    const uint32_t width = 1 + rng() % 5;
+    for (uint32_t j = 0; j < width; j++)
+    {
+      if (rng() & 1) text += "-";
+      text += std::to_string(1 + rng() % nvars) + " ";
+    }
+    text += (i % 1000 == 0) ? "0  \r\n" : "0\n";
+    if (i == nclauses / 2) text += "c halfway\n\ne 901 902 0\n";
+    if (i == 3 * nclauses / 4) text += "a 903 0\n";
+  }
+  return text;
+}
+
+string write_temp(const string& text)
+{
+  char path[] = "/tmp/skolemfc-reader-test-XXXXXX";
+  const int fd = mkstemp(path);
+  if (fd < 0) return "";
+  const bool ok = write(fd, text.data(), text.size()) == (ssize_t)text.size();
+  close(fd);
+  if (!ok)
+  {
+    unlink(path);
+    return "";
+  }
+  return path;
+}
+
+struct BadInput
+{
+  const char* what;
+  string text;
+  uint64_t line;   // that the mapped reader must name
+  bool same_line;  // DimacsParser names that line too
+};
+
+// Both readers must refuse text, and the mapped reader name the line
+void check_error(const BadInput& bad, uint32_t& failures)
+{
+  string text = bad.text;
+  SklFC streamed, mapped;
+  string streamed_error, mapped_error;
+  FILE* in = fmemopen(&text[0], text.size(), "r");
+  const bool streamed_ok = parse_streaming(in, streamed, streamed_error);
+  fclose(in);
+  bool mapped_ok;
+  {
+    Quiet quiet;
+    mapped_ok = parse_qdimacs(
+        text.data(), text.size(), &mapped, threads, 0, mapped_error);
+  }
+
+  const string line = "line " + std::to_string(bad.line);
+  string problem;
+  if (streamed_ok) problem = "DimacsParser accepted it";
+  else if (mapped_ok) problem = "mapped reader accepted it";
+  else if (mapped_error.compare(0, line.size() + 1, line + ":") != 0)
+    problem = "mapped reader said '" + mapped_error + "'";
+  else if (bad.same_line && streamed_error.find(line + "\n") == string::npos
+           && streamed_error.find(line + " ") == string::npos)
+    problem = "DimacsParser said '" + streamed_error + "'";
+  if (problem.empty())
+  {
+    cout << "ok   " << bad.what << ": " << mapped_error << endl;
+    return;
+  }
+  cout << "FAIL " << bad.what << ": " << problem << endl;
+  failures++;
+}
+
+}  // namespace
+
+int main(int argc, char** argv)
+{
+  if (argc != 2)
+  {
+    cout << "usage: " << argv[0] << " <examples directory>" << endl;
+    return 1;
+  }
+  uint32_t failures = 0;
+
+  vector<string> files;
+  DIR* dir = opendir(argv[1]);
+  if (dir == NULL)
+  {
+    cout << "could not open '" << argv[1] << "'" << endl;
+    return 1;
+  }
+  while (const dirent* entry = readdir(dir))
+  {
+    const string name = entry->d_name;
+    if (name.size() > 8 && name.substr(name.size() - 8) == ".qdimacs")
+      files.push_back(string(argv[1]) + "/" + name);
+  }
+  closedir(dir);
+  std::sort(files.begin(), files.end());
+  if (files.empty())
+  {
+    cout << "FAIL no .qdimacs files in '" << argv[1] << "'" << endl;
+    failures++;
+  }
+  for (const string& f : files) check_file(f, failures);
+
+  const uint32_t nclauses = 300000;
+  const string big = generated_formula(nclauses);
+  const string big_path = write_temp(big);
+  if (big_path.empty())
+  {
+    cout << "FAIL could not write the generated formula" << endl;
+    failures++;
+  }
+  else
+  {
+    cout << "generated " << big.size() / (1 << 20) << " MB" << endl;
+    check_file(big_path, failures);
+    unlink(big_path.c_str());
+  }
+
+  // An error at the end of the generated formula lies in its last chunk
+  const uint64_t big_lines = std::count(big.begin(), big.end(), '\n');
+  const vector<BadInput> bad = {
+      {"variable over the header", "p cnf 3 2\n1 2 0\n1 4 0\n", 3, true},
+      {"tab between literals", "p cnf 3 1\n1\t2 0\n", 2, true},
+      {"no closing 0", "p cnf 3 2\n1 2 0\n1 2\n", 3, false},
+      {"junk in a clause", "p cnf 3 2\n1 0\n1 x 0\n", 3, false},
+      {"junk after the 0", "p cnf 3 1\n1 2 0 3\n", 2, false},
+      {"no header", "c only a comment\n1 2 0\n", 2, false},
+      {"header twice", "p cnf 3 1\np cnf 3 1\n1 0\n", 2, false},
+      {"not cnf", "p dnf 3 1\n1 0\n", 1, false},
+      {"junk in a quantifier", "p cnf 3 1\na 1 x 0\n1 0\n", 2, false},
+      {"late in a big file",
+       big + "1 2 " + std::to_string(1001) + " 0\n",
+       big_lines + 1,
+       true},
+  };
+  for (const BadInput& b : bad) check_error(b, failures);
+
+  cout << failures << " failures" << endl;
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,135 @@
+#!/usr/bin/env python3
+# Copyright (C) 2024, Arijit Shaw, Brendan Juba, and Kuldeep S. Meel
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+# THE SOFTWARE.
+
+# Checks `skolemfc --serve` over its socket. Every formula is sent twice to
+# one server. The first answer must have an "s fc" line and reuse nothing
+# (the warm cache holds no entry keyed by this formula yet); the second must
+# reuse the earlier work and give the same count.
+#
+#   utils/serve_check.py --skolemfc build/skolemfc examples/*.qdimacs
+
+import argparse
+import glob
+import os
+import socket
+import subprocess
+import sys
+import tempfile
+import time
+
+
+def ask(path, formula, timeout):
+    with open(formula, "rb") as f:
+        data = f.read()
+    s = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+    s.settimeout(timeout)
+    s.connect(path)
+    s.sendall(data)
+    s.shutdown(socket.SHUT_WR)
+    out = b""
+    while True:
+        chunk = s.recv(65536)
+        if not chunk:
+            break
+        out += chunk
+    s.close()
+    return out.decode(errors="replace").splitlines()
+
+
+def count_line(lines):
+    for line in lines:
+        if line.startswith("e "):
+            return None
+        if line.startswith("s fc "):
+            return line
+    return None
+
+
+def reuse_lines(lines):
+    return [l for l in lines if l.startswith("c [sklfc] reusing ")]
+
+
+def main():
+    ap = argparse.ArgumentParser(
+        description="Send every formula twice to skolemfc --serve")
+    ap.add_argument("--skolemfc", default="./skolemfc")
+    ap.add_argument("--timeout", type=float, default=600,
+                    help="seconds allowed for one answer")
+    ap.add_argument("--arg", action="append", default=[],
+                    help="extra option for the server, may repeat")
+    ap.add_argument("formulas", nargs="*")
+    args = ap.parse_args()
+
+    formulas = args.formulas
+    if not formulas:
+        here = os.path.dirname(os.path.abspath(__file__))
+        formulas = sorted(glob.glob(os.path.join(here, "..", "examples",
+                                                 "*.qdimacs")))
+
+    tmp = tempfile.mkdtemp(prefix="skolemfc_serve_")
+    path = os.path.join(tmp, "sock")
+    log = open(os.path.join(tmp, "server.log"), "w")
+    server = subprocess.Popen([args.skolemfc, "--serve", path] + args.arg,
+                              stdout=log, stderr=subprocess.STDOUT)
+    failures = 0
+    try:
+        deadline = time.time() + 30
+        while not os.path.exists(path):
+            if server.poll() is not None or time.time() > deadline:
+                print("FAIL: server did not come up, see %s" % log.name)
+                return 1
+            time.sleep(0.1)
+
+        for formula in formulas:
+            name = os.path.basename(formula)
+            first = ask(path, formula, args.timeout)
+            second = ask(path, formula, args.timeout)
+            problems = []
+            if count_line(first) is None:
+                problems.append("no 's fc' line in the first answer")
+            if reuse_lines(first):
+                problems.append("first answer reused work: %s"
+                                % reuse_lines(first))
+            if count_line(second) is None:
+                problems.append("no 's fc' line in the second answer")
+            elif count_line(second) != count_line(first):
+                problems.append("counts differ: '%s' then '%s'"
+                                % (count_line(first), count_line(second)))
+            if not reuse_lines(second):
+                problems.append("second answer reused nothing")
+
+            if problems:
+                failures += 1
+                print("FAIL %s: %s" % (name, "; ".join(problems)))
+            else:
+                print("ok   %s: %s, reused %d kind(s) of work"
+                      % (name, count_line(second), len(reuse_lines(second))))
+    finally:
+        server.kill()
+        server.wait()
+        log.close()
+
+    print("%d of %d formulas failed" % (failures, len(formulas)))
+    return 1 if failures else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())